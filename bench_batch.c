@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lctrie_ip.h"
+#include "lctrie.h"
+#include "lctrie_bench.h"
+
+// batch lookup throughput over uniformly random addresses for a range of
+// batch sizes, from pipeline sized batches up to offline log processing
+int main(int argc, char *argv[]) {
+  uint32_t sizes[] = { 256, 4096, 65536, 1048576 };
+  bench_opts_t opts;
+  lct_subnet_t *p, **results;
+  lct_t t;
+  uint32_t *keys, n;
+  double samples[BENCH_MAX_REPS], start;
+  char metric[64];
+  int num;
+
+  bench_parse(&opts, argc, argv);
+  if ((num = bench_load(&opts, &p)) < 0)
+    exit(EXIT_FAILURE);
+  num = bench_prepare(p, num);
+
+  results = (lct_subnet_t **) malloc(opts.nkeys * sizeof(lct_subnet_t *));
+  if (bench_build(&opts, &t, p, num) || !(keys = bench_keys(opts.nkeys, 1)) || !results)
+    exit(EXIT_FAILURE);
+
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    for (int i = -opts.warmup; i < opts.reps; ++i) {
+      start = bench_now();
+      for (uint32_t off = 0; off < opts.nkeys; off += n) {
+        n = (opts.nkeys - off < sizes[s]) ? opts.nkeys - off : sizes[s];
+        if (lct_find_batch(&t, &keys[off], &results[off], n))
+          exit(EXIT_FAILURE);
+      }
+      if (i >= 0)
+        samples[i] = opts.nkeys / (bench_now() - start) / 1e6;
+    }
+
+    snprintf(metric, sizeof(metric), "lct_find_batch/%u", sizes[s]);
+    bench_report(&opts, "batch", metric, "Mlookups/s", samples, opts.reps);
+  }
+  bench_finish(&opts);
+
+  free(results);
+  free(keys);
+  lct_free(&t);
+  free(p);
+  return 0;
+}
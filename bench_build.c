@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lctrie_ip.h"
+#include "lctrie.h"
+#include "lctrie_bench.h"
+
+// time building the trie from an already prepared subnet array
+int main(int argc, char *argv[]) {
+  bench_opts_t opts;
+  lct_subnet_t *p;
+  lct_t t;
+  double samples[BENCH_MAX_REPS], start, took;
+  int num;
+
+  bench_parse(&opts, argc, argv);
+  if ((num = bench_load(&opts, &p)) < 0)
+    exit(EXIT_FAILURE);
+  num = bench_prepare(p, num);
+
+  for (int i = -opts.warmup; i < opts.reps; ++i) {
+    start = bench_now();
+    if (bench_build(&opts, &t, p, num)) {
+      fprintf(stderr, "Failed to build the trie\n");
+      exit(EXIT_FAILURE);
+    }
+    took = bench_now() - start;
+    lct_free(&t);
+
+    if (i >= 0)
+      samples[i] = took * 1e3;
+  }
+
+  bench_report(&opts, "build", "lct_build", "ms", samples, opts.reps);
+  bench_finish(&opts);
+
+  free(p);
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lctrie_ip.h"
+#include "lctrie.h"
+#include "lctrie_cache.h"
+#include "lctrie_bench.h"
+
+// keep the compiler from throwing the lookups away
+static volatile uint32_t sink;
+
+static
+double run_find(lct_t *t, const uint32_t *keys, uint32_t n) {
+  uint32_t hits = 0;
+  double start = bench_now();
+
+  for (uint32_t i = 0; i < n; ++i)
+    hits += (lct_find(t, keys[i]) != NULL);
+
+  sink = hits;
+  return bench_now() - start;
+}
+
+static
+double run_find_idx(lct_t *t, const uint32_t *keys, uint32_t n) {
+  uint32_t hits = 0;
+  double start = bench_now();
+
+  for (uint32_t i = 0; i < n; ++i)
+    hits += (lct_find_idx(t, keys[i]) != IP_PREFIX_NIL);
+
+  sink = hits;
+  return bench_now() - start;
+}
+
+// random keys all miss the cache, so this is its overhead on top of the
+// trie rather than its benefit
+static
+double run_cache(lct_t *t, const uint32_t *keys, uint32_t n) {
+  lct_cache_t cache;
+  uint32_t hits = 0;
+  double start;
+
+  if (lct_cache_init(&cache, 4096))
+    exit(EXIT_FAILURE);
+
+  start = bench_now();
+  for (uint32_t i = 0; i < n; ++i)
+    hits += (lct_cache_find(&cache, t, keys[i]) != NULL);
+  start = bench_now() - start;
+
+  lct_cache_free(&cache);
+  sink = hits;
+  return start;
+}
+
+static const struct {
+  const char *name;
+  double (*run)(lct_t *t, const uint32_t *keys, uint32_t n);
+} engines[] = {
+  { "lct_find", run_find },
+  { "lct_find_idx", run_find_idx },
+  { "lct_cache_find", run_cache },
+};
+
+// lookup throughput of one key at a time over uniformly random addresses
+int main(int argc, char *argv[]) {
+  bench_opts_t opts;
+  lct_subnet_t *p;
+  lct_t t;
+  uint32_t *keys;
+  double samples[BENCH_MAX_REPS], took;
+  int num;
+
+  bench_parse(&opts, argc, argv);
+  if ((num = bench_load(&opts, &p)) < 0)
+    exit(EXIT_FAILURE);
+  num = bench_prepare(p, num);
+
+  if (bench_build(&opts, &t, p, num) || !(keys = bench_keys(opts.nkeys, 1)))
+    exit(EXIT_FAILURE);
+
+  for (int e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e) {
+    for (int i = -opts.warmup; i < opts.reps; ++i) {
+      took = engines[e].run(&t, keys, opts.nkeys);
+      if (i >= 0)
+        samples[i] = opts.nkeys / took / 1e6;
+    }
+    bench_report(&opts, "lookup", engines[e].name, "Mlookups/s", samples, opts.reps);
+  }
+  bench_finish(&opts);
+
+  free(keys);
+  lct_free(&t);
+  free(p);
+  return 0;
+}
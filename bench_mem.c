@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/resource.h>
+
+#include "lctrie_ip.h"
+#include "lctrie.h"
+#include "lctrie_bench.h"
+
+// cache line and page sizes the node layout is measured against
+#define MEM_LINE    64
+#define MEM_PAGE    4096
+
+// average number of distinct cache lines and pages of the node array
+// touched per lookup, walking the trie down to the leaf for every key
+static
+void touched(const lct_t *t, const uint32_t *keys, uint32_t n, double *lines,
+             double *pages) {
+  uintptr_t line[34], page[34];
+  const lct_node_t *node;
+  int pos, branch, nline, npage, j;
+  uint32_t idx;
+  uint64_t tlines = 0, tpages = 0;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    node = &t->root[0];
+    pos = node->skip;
+    branch = node->branch;
+    idx = node->index;
+    nline = npage = 0;
+    for (;;) {
+      // a path is never more than 33 nodes deep, so just scan for repeats
+      for (j = 0; j < nline && line[j] != (uintptr_t) node / MEM_LINE; ++j);
+      if (j == nline)
+        line[nline++] = (uintptr_t) node / MEM_LINE;
+      for (j = 0; j < npage && page[j] != (uintptr_t) node / MEM_PAGE; ++j);
+      if (j == npage)
+        page[npage++] = (uintptr_t) node / MEM_PAGE;
+
+      if (branch == 0)
+        break;
+      node = &t->root[idx + EXTRACT(pos, branch, keys[i])];
+      pos += branch + node->skip;
+      branch = node->branch;
+      idx = node->index;
+    }
+    tlines += nline;
+    tpages += npage;
+  }
+
+  *lines = (double) tlines / n;
+  *pages = (double) tpages / n;
+}
+
+// memory footprint of the built trie, broken down by array.  the sizes
+// don't change from one build to the next, so there is a single sample of
+// each and the warmup and repetition options don't apply.  the lines and
+// pages of the node array touched per lookup, which depend on the layout,
+// are averaged over the lookup keys.
+int main(int argc, char *argv[]) {
+  bench_opts_t opts;
+  lct_subnet_t *p;
+  lct_t t;
+  struct rusage ru;
+  double nodes, bases, hot, chain, filter, subnets, lookup, total, per, rss;
+  double depth, root, fill, lines, pages;
+  uint32_t *keys;
+  int num;
+
+  bench_parse(&opts, argc, argv);
+  if ((num = bench_load(&opts, &p)) < 0)
+    exit(EXIT_FAILURE);
+  num = bench_prepare(p, num);
+
+  if (bench_build(&opts, &t, p, num))
+    exit(EXIT_FAILURE);
+
+  nodes = t.ncount * sizeof(lct_node_t);
+  bases = t.bcount * sizeof(uint32_t);
+  hot = t.hot ? t.scount * sizeof(lct_hot_t) : 0;
+  chain = t.chain ? (t.scount + 1 + t.chainoff[t.scount]) * sizeof(uint32_t) : 0;
+  filter = t.filter ? (1 << t.filter_bits >> 6) * sizeof(lct_filter_t) +
+                      t.filter_runs * sizeof(uint32_t) : 0;
+  subnets = t.scount * sizeof(lct_subnet_t);
+  getrusage(RUSAGE_SELF, &ru);
+  rss = ru.ru_maxrss * 1024.0;
+
+  lookup = nodes + bases + hot + chain + filter;
+  total = lookup + subnets;
+  per = lookup / t.scount;
+  depth = t.exp_depth;
+  root = t.root_branch;
+  fill = t.fill;
+
+  if (!(keys = bench_keys(opts.nkeys, 1)))
+    exit(EXIT_FAILURE);
+  touched(&t, keys, opts.nkeys, &lines, &pages);
+  free(keys);
+
+  opts.warmup = 0;
+  bench_report(&opts, "mem", "nodes", "bytes", &nodes, 1);
+  bench_report(&opts, "mem", "bases", "bytes", &bases, 1);
+  bench_report(&opts, "mem", "hot", "bytes", &hot, 1);
+  bench_report(&opts, "mem", "chain", "bytes", &chain, 1);
+  bench_report(&opts, "mem", "filter", "bytes", &filter, 1);
+  bench_report(&opts, "mem", "subnets", "bytes", &subnets, 1);
+  bench_report(&opts, "mem", "lookup_total", "bytes", &lookup, 1);
+  bench_report(&opts, "mem", "total", "bytes", &total, 1);
+  bench_report(&opts, "mem", "lookup_per_subnet", "bytes", &per, 1);
+  bench_report(&opts, "mem", "peak_rss", "bytes", &rss, 1);
+  bench_report(&opts, "mem", "expected_depth", "nodes", &depth, 1);
+  bench_report(&opts, "mem", "root_branch", "bits", &root, 1);
+  bench_report(&opts, "mem", "fill", "percent", &fill, 1);
+  bench_report(&opts, "mem", "node_lines", "lines/lookup", &lines, 1);
+  bench_report(&opts, "mem", "node_pages", "pages/lookup", &pages, 1);
+  bench_finish(&opts);
+
+  lct_free(&t);
+  free(p);
+  return 0;
+}
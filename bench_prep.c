@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lctrie_ip.h"
+#include "lctrie_bench.h"
+
+#define PREP_STEPS    5
+
+// time each of the preprocessing steps between reading a prefix table and
+// building the trie, on a fresh copy of the raw table every trial
+int main(int argc, char *argv[]) {
+  static double samples[PREP_STEPS][BENCH_MAX_REPS];
+  const char *steps[PREP_STEPS] = { "subnet_mask", "qsort", "subnet_dedup",
+                                    "subnet_prefix", "total" };
+  bench_opts_t opts;
+  lct_subnet_t *raw, *p;
+  lct_ip_stats_t *stats;
+  double t[PREP_STEPS];
+  int num, n;
+
+  bench_parse(&opts, argc, argv);
+  if ((num = bench_load(&opts, &raw)) < 0)
+    exit(EXIT_FAILURE);
+
+  p = (lct_subnet_t *) malloc(num * sizeof(lct_subnet_t));
+  stats = (lct_ip_stats_t *) malloc(num * sizeof(lct_ip_stats_t));
+  if (!p || !stats) {
+    fprintf(stderr, "Could not allocate preprocessing buffers\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = -opts.warmup; i < opts.reps; ++i) {
+    memcpy(p, raw, num * sizeof(lct_subnet_t));
+    memset(stats, 0, num * sizeof(lct_ip_stats_t));
+
+    // dedup reports every duplicate on stdout
+    bench_quiet(1);
+    t[0] = bench_now();
+    subnet_mask(p, num);
+    t[1] = bench_now();
+    qsort(p, num, sizeof(lct_subnet_t), subnet_cmp);
+    t[2] = bench_now();
+    n = num - subnet_dedup(p, num);
+    t[3] = bench_now();
+    subnet_prefix(p, stats, n);
+    t[4] = bench_now();
+    bench_quiet(0);
+
+    if (i < 0)
+      continue;
+    for (int s = 0; s < PREP_STEPS - 1; ++s)
+      samples[s][i] = (t[s + 1] - t[s]) * 1e3;
+    samples[PREP_STEPS - 1][i] = (t[PREP_STEPS - 1] - t[0]) * 1e3;
+  }
+
+  for (int s = 0; s < PREP_STEPS; ++s)
+    bench_report(&opts, "prep", steps[s], "ms", samples[s], opts.reps);
+  bench_finish(&opts);
+
+  free(stats);
+  free(p);
+  free(raw);
+  return 0;
+}
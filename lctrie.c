@@ -1,6 +1,7 @@
 #include "lctrie.h"
 
 #include <stdio.h>
+#include <string.h>
 
 // a large root branch performs best under testing
 // and splits up the search space size of the sub-branches
@@ -11,8 +12,58 @@
 // A branch fill factor of 50%
 #define FILLFACT          50
 
+// the subnet fields used for matching keys during a lookup live in
+// the packed hot array when it's split out, otherwise in the subnets.
+#if LCT_HOT_SPLIT
+#define LCT_HOT(trie)     ((trie)->hot)
+#else
+#define LCT_HOT(trie)     ((trie)->nets)
+#endif
+
+// do the first len bits of an address xor'd with a subnet's all come out
+// zero?  shifted in 64 bits so that a /0 default route matches everything.
+#define PREFIX_MATCH(len, diff)   (((uint64_t) (diff) >> (32 - (len))) == 0)
+
+// the traversal shared by the lookups, which the filter build uses too
+static inline uint32_t find_idx(lct_t *trie, uint32_t key, int *bits);
+
+// every build gets a new generation number so anything caching lookup
+// results can tell when the trie has been rebuilt out from under it
+static uint32_t generation = 0;
+
+// root branches and fill factors tried by a memory budgeted build
+static const uint8_t budget_branches[] = { 8, 10, 12, 14, 16, 18, 20 };
+static const uint8_t budget_fills[] = { 25, 50, 75, 100 };
+
+// state shared by the whole recursive build of the trie nodes.
+// keys holds the address of every base back to back, in the same order
+// as the bases, so the build never has to chase a base index into the
+// subnet array just to look at its address bits.
+typedef struct build_ctx {
+  const uint32_t *keys;
+  uint32_t nkeys;
+  uint8_t root_branch;
+  uint8_t fill;
+  const uint64_t *wsum; // running sum of the profile weight up to each base,
+                        // NULL without a profile
+  uint32_t ncap;        // trie nodes allocated so far
+  double exp_depth;     // expected depth of a uniformly random lookup
+  int failed;           // ran out of memory growing the node array
+} build_ctx_t;
+
+// shrink an array down to what was used.  an allocator can fail to map
+// the smaller copy, in which case the original is just as good to keep.
 static
-uint8_t compute_skip(lct_t *trie, uint32_t prefix, uint32_t first,
+void *mem_shrink(const lct_allocator_t *alloc, void *ptr, size_t size) {
+  void *shrunk;
+
+  if (!ptr || !(shrunk = lct_mem_realloc(alloc, ptr, size)))
+    return ptr;
+  return shrunk;
+}
+
+static
+uint8_t compute_skip(const uint32_t *keys, uint32_t prefix, uint32_t first,
                          uint32_t num, uint32_t *newprefix) {
   uint32_t low, high;
   uint32_t i;
@@ -23,8 +74,8 @@ uint8_t compute_skip(lct_t *trie, uint32_t prefix, uint32_t first,
   }
 
   // Compute the new prefix
-  low = REMOVE(prefix, trie->nets[trie->bases[first]].addr);
-  high = REMOVE(prefix, trie->nets[trie->bases[first + num - 1]].addr);
+  low = REMOVE(prefix, keys[first]);
+  high = REMOVE(prefix, keys[first + num - 1]);
   i = prefix;
   while (EXTRACT(i, 1, low) == EXTRACT(i, 1, high))
     i++;
@@ -33,10 +84,32 @@ uint8_t compute_skip(lct_t *trie, uint32_t prefix, uint32_t first,
   return (*newprefix - prefix);
 }
 
+// fill factor the node over num bases from first has to meet.  with a
+// profile it's scaled down by how many times its share of the bases the
+// node's share of the traffic is.  cold nodes keep the normal fill factor.
+static
+int node_fill(const build_ctx_t *ctx, uint32_t first, uint32_t num) {
+  double density, fill;
+  int lowest;
+
+  if (!ctx->wsum || !ctx->wsum[ctx->nkeys])
+    return ctx->fill;
+
+  density = ((double) (ctx->wsum[first + num] - ctx->wsum[first]) / ctx->wsum[ctx->nkeys]) *
+            ((double) ctx->nkeys / num);
+  lowest = (ctx->fill + LCT_PROFILE_MAX_WIDEN - 1) / LCT_PROFILE_MAX_WIDEN;
+  if (density <= 1)
+    return ctx->fill;
+  fill = ctx->fill / density;
+  return (fill < lowest) ? lowest : (int) fill;
+}
+
 static
-uint8_t compute_branch(lct_t *trie, uint32_t prefix, uint32_t first,
+uint8_t compute_branch(const build_ctx_t *ctx, uint32_t prefix, uint32_t first,
                            uint32_t num, uint32_t newprefix) {
-  int i, pat, bits, count, patfound;
+  const uint32_t *keys = ctx->keys;
+  uint32_t hist[33] = { 0 }, diff;
+  int i, bits, count, fill;
 
   // branch factor results in 1 << branch trie subnodes
 
@@ -48,51 +121,64 @@ uint8_t compute_branch(lct_t *trie, uint32_t prefix, uint32_t first,
   // a large root factor may waste entries for the same base off of the root,
   // but performs exceptionally better for longer prefix matches.
   if ((prefix == 0) && (first == 0)) {
-    return ROOT_BRANCH;
+    return (newprefix + ctx->root_branch > 32) ? 32 - newprefix : ctx->root_branch;
+  }
+
+  // the keys are sorted and all agree on the bits up to newprefix, so every
+  // neighboring pair first differing within the next b bits starts a new
+  // b bit pattern.  one pass bucketing the pairs by where they first differ
+  // gives the number of distinct patterns for every width at once.
+  for (i = first + 1; i < first + num; ++i) {
+    diff = keys[i - 1] ^ keys[i];
+    ++hist[diff ? __builtin_clz(diff) - newprefix : 32 - newprefix];
   }
 
   // Compute the number of bits that can be used for branching.
   // We have at least two branches. Therefore we start the search
   // at 2^b = 4 branches.
+  fill = node_fill(ctx, first, num);
   bits = 1;
+  count = 1 + hist[0];
   do {
     bits++;
-    if (num < ((FILLFACT * (1<<bits)) / 100) ||
-        newprefix + bits > sizeof(uint32_t))
+    if (num < ((fill * (1<<bits)) / 100) ||
+        newprefix + bits > 32)
       break;
-    i = first;
-    pat = 0;
-    count = 0;
-    while (pat < 1<<bits) {
-      patfound = 0;
-      while (i < first + num &&
-             pat == EXTRACT(newprefix, bits, trie->nets[trie->bases[i]].addr)) {
-        i++;
-        patfound = 1;
-      }
-      if (patfound)
-        count++;
-      pat++;
-    }
-  } while (count >= ((FILLFACT * (1<<bits)) / 100));
+    count += hist[bits - 1];
+  } while (count >= ((fill * (1<<bits)) / 100));
   return bits - 1;
 }
 
+// share is the fraction of the address space routed to the leaf
+static inline
+void build_leaf(lct_t *trie, build_ctx_t *ctx, uint32_t base, uint32_t pos,
+                uint32_t depth, double share) {
+  trie->root[pos].branch = 0;
+  trie->root[pos].skip = 0;
+  trie->root[pos].index = base;
+  ctx->exp_depth += share * depth;
+}
+
 static
-void build_inner(lct_t *trie, uint32_t prefix, uint32_t first, uint32_t num, uint32_t pos) {
+void build_inner(lct_t *trie, build_ctx_t *ctx, uint32_t prefix, uint32_t first,
+                 uint32_t num, uint32_t pos, uint32_t depth, double share) {
+  const uint32_t *keys = ctx->keys;
   int k, p, idx, bits;
   uint32_t bitpat, newprefix = 0, i;
   uint8_t branch;
+  lct_node_t *grown;
+
+  if (ctx->failed)
+    return;
 
   if (num == 1) {
-    trie->root[pos].branch = 0;
-    trie->root[pos].skip = 0;
-    trie->root[pos].index = first;
+    build_leaf(trie, ctx, first, pos, depth, share);
   }
   else {
     // calculate the skip and branch for this node
-    trie->root[pos].skip = compute_skip(trie, prefix, first, num, &newprefix);
-    branch = trie->root[pos].branch = compute_branch(trie, prefix, first, num, newprefix);
+    trie->root[pos].skip = compute_skip(keys, prefix, first, num, &newprefix);
+    branch = trie->root[pos].branch = compute_branch(ctx, prefix, first, num, newprefix);
+    share /= 1 << branch;
 
     // get a pointer to the next unused trie node which is conveniently
     // located at trie->ncount since our caller allocated this node
@@ -100,7 +186,18 @@ void build_inner(lct_t *trie, uint32_t prefix, uint32_t first, uint32_t num, uin
     idx = trie->ncount;
     trie->root[pos].index = idx;
 
-    // ok, we need to allocate our child nodes before we recurse over them
+    // ok, we need to allocate our child nodes before we recurse over them,
+    // doubling the node array whenever they don't fit
+    if (trie->ncount + (1 << branch) > ctx->ncap) {
+      while (trie->ncount + (1 << branch) > ctx->ncap)
+        ctx->ncap *= 2;
+      grown = (lct_node_t *) lct_mem_realloc(&trie->alloc, trie->root, ctx->ncap * sizeof(lct_node_t));
+      if (!grown) {
+        ctx->failed = 1;
+        return;
+      }
+      trie->root = grown;
+    }
     trie->ncount += 1 << branch;
 
     // Build the subtrees
@@ -108,7 +205,7 @@ void build_inner(lct_t *trie, uint32_t prefix, uint32_t first, uint32_t num, uin
     for (bitpat = 0; bitpat < (1 << branch); ++bitpat) {
       k = 0;
       while (p + k < first + num &&
-             EXTRACT(newprefix, branch, trie->nets[trie->bases[p + k]].addr) == bitpat) {
+             EXTRACT(newprefix, branch, keys[p + k]) == bitpat) {
         ++k;
       }
 
@@ -120,67 +217,798 @@ void build_inner(lct_t *trie, uint32_t prefix, uint32_t first, uint32_t num, uin
         // Compute the longest prefix match for p - 1
         if (p > first) {
           int prep, len;
-          prep =  trie->nets[trie->bases[p - 1]].prefix;
+          prep =  LCT_HOT(trie)[trie->bases[p - 1]].prefix;
           while (prep != IP_PREFIX_NIL && match1 == 0) {
-            len = trie->nets[prep].len;
+            len = LCT_HOT(trie)[prep].len;
             if (len > newprefix &&
-                EXTRACT(newprefix, len - newprefix, trie->nets[trie->bases[p - 1]].addr) ==
+                EXTRACT(newprefix, len - newprefix, keys[p - 1]) ==
                 EXTRACT(32 - branch, len - newprefix, bitpat))
               match1 = len;
             else
-              prep = trie->nets[prep].prefix;
+              prep = LCT_HOT(trie)[prep].prefix;
           }
         }
 
         // Compute the longest prefix match for p
         if (p < first + num) {
           int prep, len;
-          prep =  trie->nets[trie->bases[p]].prefix;
+          prep =  LCT_HOT(trie)[trie->bases[p]].prefix;
           while (prep != IP_PREFIX_NIL && match2 == 0) {
-            len = trie->nets[prep].len;
+            len = LCT_HOT(trie)[prep].len;
             if (len > newprefix &&
-                EXTRACT(newprefix, len - newprefix, trie->nets[trie->bases[p]].addr) ==
+                EXTRACT(newprefix, len - newprefix, keys[p]) ==
                 EXTRACT(32 - branch, len - newprefix, bitpat))
               match2 = len;
             else
-              prep = trie->nets[prep].prefix;
+              prep = LCT_HOT(trie)[prep].prefix;
           }
         }
 
         if ((match1 > match2 && p > first) || p == first + num)
-          build_inner(trie, newprefix + branch, p - 1, 1, idx + bitpat);
+          build_leaf(trie, ctx, p - 1, idx + bitpat, depth + 1, share);
         else
-          build_inner(trie, newprefix + branch, p, 1, idx + bitpat);
-      } else if (k == 1 && trie->nets[trie->bases[p]].len - newprefix < branch) {
-        bits = branch - trie->nets[trie->bases[p]].len + newprefix;
+          build_leaf(trie, ctx, p, idx + bitpat, depth + 1, share);
+      } else if (k == 1 && LCT_HOT(trie)[trie->bases[p]].len - newprefix < branch) {
+        bits = branch - LCT_HOT(trie)[trie->bases[p]].len + newprefix;
         for (i = bitpat; i < bitpat + (1 << bits); i++)
-          build_inner(trie, newprefix + branch, p, 1, idx + i);
+          build_leaf(trie, ctx, p, idx + i, depth + 1, share);
         bitpat += (1 << bits) - 1;
-      } else
-        build_inner(trie, newprefix + branch, p, k, idx + bitpat);
+      } else if (k == 1)
+        build_leaf(trie, ctx, p, idx + bitpat, depth + 1, share);
+      else
+        build_inner(trie, ctx, newprefix + branch, p, k, idx + bitpat, depth + 1, share);
       p += k;
     }
   }
 }
 
+// lay the covering prefix chains of every subnet out back to back.
+// a subnet's prefixes always sort before it, so its chain is just its
+// immediate prefix followed by the already computed chain of that prefix.
+static
+int build_chains(lct_t *trie) {
+  uint32_t i, fp, len;
+
+  trie->chain = NULL;
+  trie->chainoff = (uint32_t *) lct_mem_alloc(&trie->alloc, (trie->scount + 1) * sizeof(uint32_t));
+  if (!trie->chainoff)
+    return -1;
+
+  trie->chainoff[0] = 0;
+  for (i = 0; i < trie->scount; ++i) {
+    fp = trie->nets[i].fullprefix;
+    len = (fp == IP_PREFIX_NIL) ? 0 : trie->chainoff[fp + 1] - trie->chainoff[fp] + 1;
+    trie->chainoff[i + 1] = trie->chainoff[i] + len;
+  }
+
+  // always allocate something so a table without prefixes still has a chain
+  trie->chain = (uint32_t *) lct_mem_alloc(&trie->alloc, (trie->chainoff[trie->scount] + 1) * sizeof(uint32_t));
+  if (!trie->chain) {
+    lct_mem_free(&trie->alloc, trie->chainoff);
+    trie->chainoff = NULL;
+    return -1;
+  }
+
+  for (i = 0; i < trie->scount; ++i) {
+    fp = trie->nets[i].fullprefix;
+    if (fp == IP_PREFIX_NIL)
+      continue;
+
+    trie->chain[trie->chainoff[i]] = fp;
+    memcpy(&trie->chain[trie->chainoff[i] + 1], &trie->chain[trie->chainoff[fp]],
+           (trie->chainoff[fp + 1] - trie->chainoff[fp]) * sizeof(uint32_t));
+  }
+
+  return 0;
+}
+
+// intern every distinct subnet info value into the attribute table and
+// give each subnet the id of its info
+static
+int build_attrs(lct_t *trie) {
+  uint32_t *slots, mask = 1, i, s;
+
+  while (mask < 2 * trie->scount)
+    mask <<= 1;
+  slots = (uint32_t *) malloc(mask * sizeof(uint32_t));
+  trie->attrs = (lct_subnet_info_t *) lct_mem_alloc(&trie->alloc, trie->scount * sizeof(lct_subnet_info_t));
+  trie->attr32 = (uint32_t *) lct_mem_alloc(&trie->alloc, trie->scount * sizeof(uint32_t));
+  if (!slots || !trie->attrs || !trie->attr32) {
+    free(slots);
+    return -1;
+  }
+  memset(slots, 0xff, mask * sizeof(uint32_t));
+  --mask;
+
+  // open addressed, so probe along until finding the info or a free slot
+  trie->acount = 0;
+  for (i = 0; i < trie->scount; ++i) {
+    s = subnet_info_hash(0, &trie->nets[i].info) & mask;
+    while (slots[s] != LCT_ATTR_NIL &&
+           !subnet_info_eq(&trie->attrs[slots[s]], &trie->nets[i].info))
+      s = (s + 1) & mask;
+    if (slots[s] == LCT_ATTR_NIL) {
+      slots[s] = trie->acount;
+      trie->attrs[trie->acount++] = trie->nets[i].info;
+    }
+    trie->attr32[i] = slots[s];
+  }
+  free(slots);
+
+  trie->attrs = (lct_subnet_info_t *) mem_shrink(&trie->alloc, trie->attrs, trie->acount * sizeof(lct_subnet_info_t));
+
+  // halve the ids when they all fit in 16 bits
+  if (trie->acount <= UINT16_MAX) {
+    trie->attr16 = (uint16_t *) lct_mem_alloc(&trie->alloc, trie->scount * sizeof(uint16_t));
+    if (!trie->attr16)
+      return -1;
+    for (i = 0; i < trie->scount; ++i)
+      trie->attr16[i] = trie->attr32[i];
+    lct_mem_free(&trie->alloc, trie->attr32);
+    trie->attr32 = NULL;
+  }
+
+  return 0;
+}
+
+// find the slot of an ASN in an open addressed table of 1 << bits slots
+// of indexes into asns, or the free slot where it belongs
+static inline
+uint32_t asn_slot(const uint32_t *slots, int bits, const uint32_t *asns, uint32_t asn) {
+  uint32_t mask = (1U << bits) - 1, s = (asn * 2654435761U) >> (32 - bits);
+
+  while (slots[s] != LCT_ATTR_NIL && asns[slots[s]] != asn)
+    s = (s + 1) & mask;
+  return s;
+}
+
+static
+int asn_cmp(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  return (x > y) - (x < y);
+}
+
+// add a subnet to the end of the CIDR blocks folded so far for an ASN,
+// returning the new end.  a subnet inside the last block is dropped, and
+// whenever the last two blocks are the two halves of one block they
+// become that block instead.
+static inline
+lct_cidr_t *asn_fold(lct_cidr_t *first, lct_cidr_t *end, uint32_t addr, uint8_t len) {
+  uint32_t size;
+
+  if (end > first && end[-1].len <= len && PREFIX_MATCH(end[-1].len, end[-1].addr ^ addr))
+    return end;
+
+  end->addr = addr;
+  end->len = len;
+  ++end;
+  while (end - first >= 2 && end[-1].len && end[-2].len == end[-1].len) {
+    size = (uint32_t) (0x100000000ULL >> end[-1].len);
+    if ((end[-2].addr & size) || end[-2].addr + size != end[-1].addr)
+      break;
+    --end[-2].len;
+    --end;
+  }
+
+  return end;
+}
+
+// list the BGP subnets of each ASN in a CSR layout, and fold each ASN's
+// subnets down to the fewest CIDR blocks.  the distinct ASNs are few, so
+// rather than sorting every subnet by ASN they're counted up in a small
+// hash table and sorted on their own, and then the subnets are dealt out
+// to their ASNs in address order, which keeps every list sorted.  each
+// subnet's block is dealt out alongside it, so the blocks fold in one
+// sequential pass.
+static
+int build_asns(lct_t *trie) {
+  uint32_t *slots, *asns, *counts, n = 0, a, i, j, s, last, id, nc;
+  lct_cidr_t c, *end;
+  int bits = 10;
+
+  // there can't be more ASNs than subnets, and only the pages of asns and
+  // counts that get used are ever touched
+  slots = (uint32_t *) malloc((1U << bits) * sizeof(uint32_t));
+  asns = (uint32_t *) malloc(trie->scount * sizeof(uint32_t));
+  counts = (uint32_t *) malloc(trie->scount * sizeof(uint32_t));
+  if (!slots || !asns || !counts) {
+    free(slots);
+    free(asns);
+    free(counts);
+    return -1;
+  }
+  memset(slots, 0xff, (1U << bits) * sizeof(uint32_t));
+
+  // count the subnets of each ASN, skipping the probe while the ASN repeats
+  trie->nasns = 0;
+  last = LCT_ATTR_NIL;
+  for (i = 0; i < trie->scount; ++i) {
+    if (trie->nets[i].info.type != IP_SUBNET_BGP)
+      continue;
+    ++n;
+    if (last != LCT_ATTR_NIL && asns[last] == trie->nets[i].info.bgp.asn) {
+      ++counts[last];
+      continue;
+    }
+
+    s = asn_slot(slots, bits, asns, trie->nets[i].info.bgp.asn);
+    if (slots[s] == LCT_ATTR_NIL) {
+      // keep the table at most half full
+      if (2 * (trie->nasns + 1) > (1U << bits)) {
+        free(slots);
+        ++bits;
+        slots = (uint32_t *) malloc((1U << bits) * sizeof(uint32_t));
+        if (!slots) {
+          free(asns);
+          free(counts);
+          return -1;
+        }
+        memset(slots, 0xff, (1U << bits) * sizeof(uint32_t));
+        for (a = 0; a < trie->nasns; ++a)
+          slots[asn_slot(slots, bits, asns, asns[a])] = a;
+        s = asn_slot(slots, bits, asns, trie->nets[i].info.bgp.asn);
+      }
+      slots[s] = trie->nasns;
+      asns[trie->nasns] = trie->nets[i].info.bgp.asn;
+      counts[trie->nasns++] = 0;
+    }
+    last = slots[s];
+    ++counts[last];
+  }
+
+  trie->asns = (uint32_t *) lct_mem_alloc(&trie->alloc, (trie->nasns ? trie->nasns : 1) * sizeof(uint32_t));
+  trie->asn_off = (uint32_t *) lct_mem_alloc(&trie->alloc, (trie->nasns + 1) * sizeof(uint32_t));
+  trie->asn_nets = (uint32_t *) lct_mem_alloc(&trie->alloc, (n ? n : 1) * sizeof(uint32_t));
+  trie->cidr_off = (uint32_t *) lct_mem_alloc(&trie->alloc, (trie->nasns + 1) * sizeof(uint32_t));
+  trie->asn_cidrs = (lct_cidr_t *) lct_mem_alloc(&trie->alloc, (n ? n : 1) * sizeof(lct_cidr_t));
+  if (!trie->asns || !trie->asn_off || !trie->asn_nets || !trie->cidr_off || !trie->asn_cidrs) {
+    free(slots);
+    free(asns);
+    free(counts);
+    return -1;
+  }
+
+  // sort the ASNs, and point their slots at their sorted positions instead
+  memcpy(trie->asns, asns, trie->nasns * sizeof(uint32_t));
+  qsort(trie->asns, trie->nasns, sizeof(uint32_t), asn_cmp);
+  for (s = 0; s < (1U << bits); ++s) {
+    if ((id = slots[s]) == LCT_ATTR_NIL)
+      continue;
+    a = (uint32_t *) bsearch(&asns[id], trie->asns, trie->nasns,
+                             sizeof(uint32_t), asn_cmp) - trie->asns;
+    trie->asn_off[a + 1] = counts[id];
+    slots[s] = a;
+  }
+  free(asns);
+  free(counts);
+
+  // deal the subnets out using cidr_off as the cursors for now
+  trie->asn_off[0] = 0;
+  for (a = 0; a < trie->nasns; ++a) {
+    trie->asn_off[a + 1] += trie->asn_off[a];
+    trie->cidr_off[a] = trie->asn_off[a];
+  }
+  for (i = 0, last = 0; i < trie->scount; ++i) {
+    if (trie->nets[i].info.type != IP_SUBNET_BGP)
+      continue;
+    if (trie->asns[last] != trie->nets[i].info.bgp.asn)
+      last = slots[asn_slot(slots, bits, trie->asns, trie->nets[i].info.bgp.asn)];
+    trie->asn_cidrs[trie->cidr_off[last]].addr = trie->nets[i].addr;
+    trie->asn_cidrs[trie->cidr_off[last]].len = trie->nets[i].len;
+    trie->asn_nets[trie->cidr_off[last]++] = i;
+  }
+  free(slots);
+
+  // then fold the blocks down in place, never writing past the next one read
+  for (a = 0, nc = 0; a < trie->nasns; ++a) {
+    trie->cidr_off[a] = nc;
+    for (j = trie->asn_off[a], end = &trie->asn_cidrs[nc]; j < trie->asn_off[a + 1]; ++j) {
+      c = trie->asn_cidrs[j];
+      end = asn_fold(&trie->asn_cidrs[nc], end, c.addr, c.len);
+    }
+    nc = end - trie->asn_cidrs;
+  }
+  trie->cidr_off[trie->nasns] = nc;
+
+  trie->asn_cidrs = (lct_cidr_t *) mem_shrink(&trie->alloc, trie->asn_cidrs, (nc ? nc : 1) * sizeof(lct_cidr_t));
+
+  return 0;
+}
+
+// summarize the trie in 1 << bits blocks.  a block is split up if and only
+// if a subnet longer than the block starts inside of it, otherwise every
+// subnet touching it covers all of it.  the answer of a uniform block is
+// the lookup of any address in it, and when the lookup was decided by no
+// more bits than the block's, it holds for the whole aligned block of that
+// many bits around it, so the big uniform stretches are skipped over whole.
+static
+int build_filter(lct_t *trie, uint8_t bits) {
+  uint32_t nblocks = 1 << bits, blk, end, idx, last = IP_PREFIX_NIL, cap = 1024, rank = 0;
+  uint32_t *grown;
+  lct_filter_t *g;
+  int decided, inrun = 0;
+
+  trie->filter_bits = bits;
+  trie->filter_runs = 0;
+  trie->filter = (lct_filter_t *) lct_mem_alloc(&trie->alloc, (nblocks >> 6) * sizeof(lct_filter_t));
+  trie->filter_ids = (uint32_t *) lct_mem_alloc(&trie->alloc, cap * sizeof(uint32_t));
+  if (!trie->filter || !trie->filter_ids)
+    return -1;
+  memset(trie->filter, 0, (nblocks >> 6) * sizeof(lct_filter_t));
+
+  // the lookups below mustn't go through the half built filter
+  g = trie->filter;
+  trie->filter = NULL;
+
+  for (blk = 0; blk < (nblocks >> 6); ++blk)
+    g[blk].uniform = UINT64_MAX;
+  for (uint32_t i = 0; i < trie->scount; ++i) {
+    if (LCT_HOT(trie)[i].len > bits) {
+      blk = LCT_HOT(trie)[i].addr >> (32 - bits);
+      g[blk >> 6].uniform &= ~(1ULL << (blk & 63));
+    }
+  }
+
+  for (blk = 0; blk < nblocks; blk = end) {
+    if (!(g[blk >> 6].uniform & (1ULL << (blk & 63)))) {
+      inrun = 0;
+      end = blk + 1;
+      continue;
+    }
+
+    idx = find_idx(trie, blk << (32 - bits), &decided);
+    end = (decided < bits) ? ((blk >> (bits - decided)) + 1) << (bits - decided) : blk + 1;
+
+    // a block with a new answer starts a run
+    if (!inrun || idx != last) {
+      if (trie->filter_runs == cap) {
+        cap *= 2;
+        grown = (uint32_t *) lct_mem_realloc(&trie->alloc, trie->filter_ids, cap * sizeof(uint32_t));
+        if (!grown) {
+          trie->filter = g;
+          return -1;
+        }
+        trie->filter_ids = grown;
+      }
+      trie->filter_ids[trie->filter_runs++] = idx;
+      g[blk >> 6].runs |= 1ULL << (blk & 63);
+      last = idx;
+      inrun = 1;
+    }
+  }
+
+  for (blk = 0; blk < (nblocks >> 6); ++blk) {
+    g[blk].rank = rank;
+    rank += __builtin_popcountll(g[blk].runs);
+  }
+
+  trie->filter = g;
+  trie->filter_ids = (uint32_t *) mem_shrink(&trie->alloc, trie->filter_ids, trie->filter_runs * sizeof(uint32_t));
+  return 0;
+}
+
+// running sums of the profile weight landing on each base, sum[i] being
+// the weight before base i.  a key lands on the last base starting at or
+// before it, or the first base.
+static
+uint64_t *profile_sums(const uint32_t *keys, uint32_t nkeys, const lct_profile_t *profile) {
+  uint64_t *sum;
+  uint32_t lo, hi, mid;
+
+  if (!(sum = (uint64_t *) calloc(nkeys + 1, sizeof(uint64_t))))
+    return NULL;
+
+  for (uint32_t i = 0; i < profile->n; ++i) {
+    for (lo = 0, hi = nkeys; hi - lo > 1;) {
+      mid = lo + (hi - lo) / 2;
+      if (keys[mid] <= profile->keys[i])
+        lo = mid;
+      else
+        hi = mid;
+    }
+    sum[lo + 1] += profile->weights ? profile->weights[i] : 1;
+  }
+
+  for (uint32_t i = 0; i < nkeys; ++i)
+    sum[i + 1] += sum[i];
+
+  return sum;
+}
+
+// build the trie nodes with the root branch and fill factor in the context
+static
+int build_nodes(lct_t *trie, build_ctx_t *ctx) {
+  // start with room for a full root and a couple of nodes per base, and
+  // grow from there as needed.  we'll shrink it down once we're done.
+  ctx->ncap = 1 + (1 << ctx->root_branch) + 2 * trie->bcount;
+  ctx->exp_depth = 0;
+  ctx->failed = 0;
+  trie->root = (lct_node_t *) lct_mem_alloc(&trie->alloc, ctx->ncap * sizeof(lct_node_t));
+  if (!trie->root)
+    return -1;
+
+  // hand off to the inner recursive function
+  trie->ncount = 1; // we start with the root node allocated
+  build_inner(trie, ctx, 0, 0, trie->bcount, 0, 0, 1.0);
+  if (ctx->failed) {
+    lct_mem_free(&trie->alloc, trie->root);
+    trie->root = NULL;
+    return -1;
+  }
+
+  // shrink down the trie node array to its actual size
+  trie->root = (lct_node_t *) mem_shrink(&trie->alloc, trie->root, trie->ncount * sizeof(lct_node_t));
+
+  return 0;
+}
+
+// try every candidate root branch and fill factor and rebuild with the
+// one giving the shallowest trie whose nodes and bases fit in the budget.
+// if none of them fit, settle for the smallest.
+static
+int build_budget(lct_t *trie, build_ctx_t *ctx, size_t budget) {
+  uint8_t best_branch = 0, best_fill = 0, small_branch = 0, small_fill = 0;
+  double best_depth = 0;
+  size_t bytes, best_bytes = 0, small_bytes = 0;
+
+  for (int b = 0; b < sizeof(budget_branches); ++b) {
+    for (int f = 0; f < sizeof(budget_fills); ++f) {
+      ctx->root_branch = budget_branches[b];
+      ctx->fill = budget_fills[f];
+      if (build_nodes(trie, ctx))
+        continue;
+
+      bytes = trie->ncount * sizeof(lct_node_t) + trie->bcount * sizeof(uint32_t);
+      lct_mem_free(&trie->alloc, trie->root);
+      trie->root = NULL;
+
+      if (!small_branch || bytes < small_bytes) {
+        small_branch = ctx->root_branch;
+        small_fill = ctx->fill;
+        small_bytes = bytes;
+      }
+      if (bytes <= budget &&
+          (!best_branch || ctx->exp_depth < best_depth ||
+           (ctx->exp_depth == best_depth && bytes < best_bytes))) {
+        best_branch = ctx->root_branch;
+        best_fill = ctx->fill;
+        best_depth = ctx->exp_depth;
+        best_bytes = bytes;
+      }
+    }
+  }
+
+  if (!small_branch)
+    return -1;
+
+  if (!best_branch) {
+    fprintf(stderr, "WARNING: no trie fits in %lu bytes, using the smallest at %lu bytes\n",
+            (unsigned long) budget, (unsigned long) small_bytes);
+    best_branch = small_branch;
+    best_fill = small_fill;
+  }
+
+  ctx->root_branch = best_branch;
+  ctx->fill = best_fill;
+  return build_nodes(trie, ctx);
+}
+
+// a block of sibling nodes, numbered breadth first from the lone root node
+// at block 0, along with the numbers of its children's blocks
+typedef struct layout_block {
+  uint32_t start;       // index of the block's first node
+  uint32_t size;        // number of nodes in the block
+  uint32_t child;       // number of the first child block
+  uint32_t nchild;      // number of child blocks, numbered consecutively
+  uint32_t height;      // levels of blocks in the subtree under it, itself
+                        // included
+  uint32_t rank;        // position in the depth first order
+  uint64_t weight;      // profile lookups walking through the block
+} layout_block_t;
+
+// state shared by the recursive layouts
+typedef struct layout_ctx {
+  const layout_block_t *blocks;
+  uint32_t *order;      // block numbers in their new order
+  uint32_t norder;
+} layout_ctx_t;
+
+static
+void layout_dfs(layout_ctx_t *ctx, uint32_t b) {
+  ctx->order[ctx->norder++] = b;
+  for (uint32_t c = 0; c < ctx->blocks[b].nchild; ++c)
+    layout_dfs(ctx, ctx->blocks[b].child + c);
+}
+
+static void layout_veb(layout_ctx_t *ctx, uint32_t b, uint32_t height);
+
+// lay out every subtree depth levels below block b, height levels deep
+static
+void layout_veb_bottoms(layout_ctx_t *ctx, uint32_t b, uint32_t depth, uint32_t height) {
+  if (depth == 0) {
+    layout_veb(ctx, b, height);
+    return;
+  }
+
+  for (uint32_t c = 0; c < ctx->blocks[b].nchild; ++c)
+    layout_veb_bottoms(ctx, ctx->blocks[b].child + c, depth - 1, height);
+}
+
+// lay out the subtree under block b cut off at height levels, the top half
+// first and then each of the bottom halves hanging off of it
+static
+void layout_veb(layout_ctx_t *ctx, uint32_t b, uint32_t height) {
+  uint32_t top;
+
+  if (height <= 1) {
+    ctx->order[ctx->norder++] = b;
+    return;
+  }
+
+  top = height / 2;
+  layout_veb(ctx, b, top);
+  layout_veb_bottoms(ctx, b, top, height - top);
+}
+
+// busiest first, and in depth first order otherwise
+static
+int layout_hot_cmp(const void *di, const void *dj) {
+  const layout_block_t *i = *(const layout_block_t * const *) di;
+  const layout_block_t *j = *(const layout_block_t * const *) dj;
+
+  if (i->weight != j->weight)
+    return (i->weight > j->weight) ? -1 : 1;
+  return (i->rank > j->rank) - (i->rank < j->rank);
+}
+
+// walk every key of the profile down to its leaf, returning the average
+// number of nodes walked below the root.  with nodeblock mapping every
+// node to its block, the weight of each block walked through is tallied
+// up in blocks as well.
+static
+double profile_walk(const lct_t *trie, const lct_profile_t *profile,
+                    const uint32_t *nodeblock, layout_block_t *blocks) {
+  const lct_node_t *node;
+  uint32_t key, idx, n;
+  uint64_t w, total = 0, steps = 0;
+  int pos, branch, depth;
+
+  for (uint32_t i = 0; i < profile->n; ++i) {
+    key = profile->keys[i];
+    w = profile->weights ? profile->weights[i] : 1;
+    node = &trie->root[0];
+    pos = node->skip;
+    branch = node->branch;
+    idx = node->index;
+    depth = 0;
+    if (nodeblock)
+      blocks[0].weight += w;
+    while (branch != 0) {
+      n = idx + EXTRACT(pos, branch, key);
+      node = &trie->root[n];
+      pos += branch + node->skip;
+      branch = node->branch;
+      idx = node->index;
+      ++depth;
+      if (nodeblock)
+        blocks[nodeblock[n]].weight += w;
+    }
+    total += w;
+    steps += w * depth;
+  }
+
+  return total ? (double) steps / total : 0;
+}
+
+int lct_relayout(lct_t *trie, int layout) {
+  return lct_relayout_profile(trie, layout, NULL);
+}
+
+int lct_relayout_profile(lct_t *trie, int layout, const lct_profile_t *profile) {
+  layout_block_t *blocks, **hot = NULL;
+  layout_ctx_t ctx;
+  lct_node_t *root;
+  uint32_t *newstart, *nodeblock = NULL, nblocks, b, i, pos, child, h;
+
+  // idiot check
+  if (!trie || !trie->root || layout < 0 || layout > LCT_LAYOUT_MAX ||
+      (layout == LCT_LAYOUT_HOT && !profile))
+    return -1;
+
+  // there can't be more blocks than nodes, since every node is in one
+  blocks = (layout_block_t *) calloc(trie->ncount, sizeof(layout_block_t));
+  ctx.order = (uint32_t *) malloc(trie->ncount * sizeof(uint32_t));
+  newstart = (uint32_t *) malloc(trie->ncount * sizeof(uint32_t));
+  if (layout == LCT_LAYOUT_HOT) {
+    nodeblock = (uint32_t *) malloc(trie->ncount * sizeof(uint32_t));
+    hot = (layout_block_t **) malloc(trie->ncount * sizeof(layout_block_t *));
+  }
+  root = (lct_node_t *) lct_mem_alloc(&trie->alloc, trie->ncount * sizeof(lct_node_t));
+  if (!blocks || !ctx.order || !newstart || !root ||
+      (layout == LCT_LAYOUT_HOT && (!nodeblock || !hot))) {
+    free(blocks);
+    free(ctx.order);
+    free(newstart);
+    free(nodeblock);
+    free(hot);
+    lct_mem_free(&trie->alloc, root);
+    return -1;
+  }
+
+  // number the blocks breadth first, so the children of every block are
+  // numbered consecutively in the order of the nodes pointing at them
+  blocks[0].start = 0;
+  blocks[0].size = 1;
+  nblocks = 1;
+  for (b = 0; b < nblocks; ++b) {
+    blocks[b].child = nblocks;
+    for (i = blocks[b].start; i < blocks[b].start + blocks[b].size; ++i) {
+      if (trie->root[i].branch) {
+        blocks[nblocks].start = trie->root[i].index;
+        blocks[nblocks].size = 1 << trie->root[i].branch;
+        ++nblocks;
+      }
+    }
+    blocks[b].nchild = nblocks - blocks[b].child;
+  }
+
+  // children are numbered after their parents
+  for (b = nblocks; b-- > 0;) {
+    blocks[b].height = 1;
+    for (i = 0; i < blocks[b].nchild; ++i) {
+      h = blocks[blocks[b].child + i].height + 1;
+      if (h > blocks[b].height)
+        blocks[b].height = h;
+    }
+  }
+
+  ctx.blocks = blocks;
+  ctx.norder = 0;
+  switch (layout) {
+    case LCT_LAYOUT_BFS:
+      for (b = 0; b < nblocks; ++b)
+        ctx.order[ctx.norder++] = b;
+      break;
+    case LCT_LAYOUT_HOT:
+      // the root node and the root block are walked through by every
+      // lookup, so they stay in front, ahead of any ties
+      layout_dfs(&ctx, 0);
+      for (i = 0; i < nblocks; ++i) {
+        blocks[ctx.order[i]].rank = i;
+        for (pos = 0; pos < blocks[ctx.order[i]].size; ++pos)
+          nodeblock[blocks[ctx.order[i]].start + pos] = ctx.order[i];
+      }
+      trie->prof_depth = profile_walk(trie, profile, nodeblock, blocks);
+      for (i = 0; i < nblocks; ++i)
+        hot[i] = &blocks[ctx.order[i]];
+      qsort(hot, nblocks, sizeof(layout_block_t *), layout_hot_cmp);
+      for (i = 0; i < nblocks; ++i)
+        ctx.order[i] = hot[i] - blocks;
+      break;
+    case LCT_LAYOUT_VEB:
+      // the root block is far too wide to share lines with anything, so
+      // each subtree hanging off of it is laid out on its own
+      ctx.order[ctx.norder++] = 0;
+      if (nblocks > 1) {
+        ctx.order[ctx.norder++] = 1;
+        for (i = 0; i < blocks[1].nchild; ++i)
+          layout_veb(&ctx, blocks[1].child + i, blocks[blocks[1].child + i].height);
+      }
+      break;
+    default:
+      layout_dfs(&ctx, 0);
+      break;
+  }
+
+  // hand out the new positions, then copy the nodes over pointing each
+  // inner node at its child block's new position
+  for (i = 0, pos = 0; i < ctx.norder; ++i) {
+    newstart[ctx.order[i]] = pos;
+    pos += blocks[ctx.order[i]].size;
+  }
+
+  for (b = 0; b < nblocks; ++b) {
+    child = blocks[b].child;
+    for (i = 0; i < blocks[b].size; ++i) {
+      root[newstart[b] + i] = trie->root[blocks[b].start + i];
+      if (root[newstart[b] + i].branch)
+        root[newstart[b] + i].index = newstart[child++];
+    }
+  }
+
+  lct_mem_free(&trie->alloc, trie->root);
+  trie->root = root;
+
+  if (profile && layout != LCT_LAYOUT_HOT)
+    trie->prof_depth = profile_walk(trie, profile, NULL, NULL);
+
+  free(blocks);
+  free(ctx.order);
+  free(newstart);
+  free(nodeblock);
+  free(hot);
+  return 0;
+}
+
+int lct_build(lct_t *trie, lct_subnet_t *subnets, uint32_t size) {
+  return lct_build_opts(trie, subnets, size, NULL);
+}
+
 // since the build algorithm is recursive, we'll pass this API entry point
 // into an interior build function
-int lct_build(lct_t *trie, lct_subnet_t *subnets, uint32_t size) {
+int lct_build_opts(lct_t *trie, lct_subnet_t *subnets, uint32_t size,
+                   const lct_opts_t *opts) {
+  build_ctx_t ctx;
+  uint32_t *keys;
+  uint64_t *wsum = NULL;
+  int rc;
+
   // why are you hitting yourself, mcfly?
   if (!trie || !subnets || !size)
     return -1;
 
+  // start with every interior array empty, so a failed build can always be
+  // cleaned up with lct_free()
+  trie->bases = NULL;
+  trie->hot = NULL;
+  trie->chainoff = NULL;
+  trie->chain = NULL;
+  trie->root = NULL;
+  trie->attrs = NULL;
+  trie->attr16 = NULL;
+  trie->attr32 = NULL;
+  trie->acount = 0;
+  trie->filter = NULL;
+  trie->filter_ids = NULL;
+  trie->filter_runs = 0;
+  trie->filter_bits = 0;
+  trie->asns = NULL;
+  trie->nasns = 0;
+  trie->asn_off = NULL;
+  trie->asn_nets = NULL;
+  trie->cidr_off = NULL;
+  trie->asn_cidrs = NULL;
+  trie->alloc = lct_libc_allocator;
+
+  if (opts && (opts->root_branch > LCT_MAX_ROOT_BRANCH || opts->fill > 100)) {
+    fprintf(stderr, "ERROR: invalid trie root branch or fill factor\n");
+    return -1;
+  }
+
+  if (opts && (opts->layout > LCT_LAYOUT_MAX ||
+               (opts->layout == LCT_LAYOUT_HOT && !opts->profile))) {
+    fprintf(stderr, "ERROR: invalid trie node layout\n");
+    return -1;
+  }
+
+  if (opts && opts->profile && opts->profile->n && !opts->profile->keys) {
+    fprintf(stderr, "ERROR: invalid trie traffic profile\n");
+    return -1;
+  }
+
+  if (opts && opts->filter_bits &&
+      (opts->filter_bits < LCT_MIN_FILTER_BITS || opts->filter_bits > LCT_MAX_FILTER_BITS)) {
+    fprintf(stderr, "ERROR: invalid trie filter block length\n");
+    return -1;
+  }
+
   // user is responsible for the outer struct,
   // and we're responsible for the interior memory
   trie->nets = subnets;
+  trie->scount = size;
+  trie->gen = __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+  if (!trie->gen)
+    trie->gen = __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+  trie->alloc = (opts && opts->alloc) ? *opts->alloc : lct_libc_allocator;
 
   // bases will never be more than size, but we will need to
   // shrink it back down after it's allocated
-  trie->bases = (uint32_t *) malloc(size * sizeof(uint32_t));
+  trie->bases = (uint32_t *) lct_mem_alloc(&trie->alloc, size * sizeof(uint32_t));
 
   // allocate and count the bases
   trie->bcount = 0;
-  if (!trie) {
+  if (!trie->bases) {
+    lct_free(trie);
     fprintf(stderr, "ERROR: failed to allocate trie bases index buffer\n");
     return -1;
   }
@@ -197,22 +1025,105 @@ int lct_build(lct_t *trie, lct_subnet_t *subnets, uint32_t size) {
   }
 
   // reallocate the base index buffer back down to the actual size.
-  trie->bases = (uint32_t *) realloc(trie->bases, trie->bcount * sizeof(uint32_t));
+  trie->bases = (uint32_t *) mem_shrink(&trie->alloc, trie->bases, trie->bcount * sizeof(uint32_t));
+
+  // split the lookup fields out of the subnets into the packed hot array
+#if LCT_HOT_SPLIT
+  trie->hot = (lct_hot_t *) lct_mem_alloc(&trie->alloc, size * sizeof(lct_hot_t));
+  if (!trie->hot) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie hot subnet buffer\n");
+    return -1;
+  }
+
+  for (int i = 0; i < size; ++i) {
+    trie->hot[i].addr = subnets[i].addr;
+    trie->hot[i].prefix = subnets[i].prefix;
+    trie->hot[i].len = subnets[i].len;
+  }
+#endif
+
+  // precompute the covering prefix chains
+  if (build_chains(trie)) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie prefix chain buffer\n");
+    return -1;
+  }
+
+  // intern the attributes if asked to
+  if (opts && opts->attrs && build_attrs(trie)) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie attribute table\n");
+    return -1;
+  }
+
+  // and index the subnets by ASN
+  if (opts && opts->asn_index && build_asns(trie)) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie ASN index\n");
+    return -1;
+  }
+
+  // pull the base addresses out into their own array for the build
+  keys = (uint32_t *) malloc(trie->bcount * sizeof(uint32_t));
+  if (!keys) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie build key buffer\n");
+    return -1;
+  }
+  for (int i = 0; i < trie->bcount; ++i)
+    keys[i] = subnets[trie->bases[i]].addr;
 
-  // give a 2MB buffer, and we'll shrink it down once we've built the trie
-  trie->root = (lct_node_t *) malloc((size + 2000000) * sizeof(lct_node_t));
-  if (!trie->root) {
-    free(trie->bases);
+  // spread the profile over the bases for shaping the trie around it
+  if (opts && opts->profile && !(wsum = profile_sums(keys, trie->bcount, opts->profile))) {
+    free(keys);
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie profile buffer\n");
+    return -1;
+  }
+
+  memset(&ctx, 0, sizeof(build_ctx_t));
+  ctx.keys = keys;
+  ctx.nkeys = trie->bcount;
+  ctx.wsum = wsum;
+  if (opts && opts->budget) {
+    rc = build_budget(trie, &ctx, opts->budget);
+  }
+  else {
+    ctx.root_branch = (opts && opts->root_branch) ? opts->root_branch : ROOT_BRANCH;
+    ctx.fill = (opts && opts->fill) ? opts->fill : FILLFACT;
+    rc = build_nodes(trie, &ctx);
+  }
+  free(keys);
+  free(wsum);
+
+  if (rc) {
+    lct_free(trie);
     fprintf(stderr, "ERROR: failed to allocate trie node buffer\n");
     return -1;
   }
 
-  // hand off to the inner recursive function
-  trie->ncount = 1; // we start with the root node allocated
-  build_inner(trie, 0, 0, trie->bcount, 0);
+  trie->root_branch = ctx.root_branch;
+  trie->fill = ctx.fill;
+  trie->exp_depth = ctx.exp_depth;
 
-  // shrink down the trie node array to its actual size
-  trie->root = (lct_node_t *) realloc(trie->root, trie->ncount * sizeof(lct_node_t));
+  // reorder the nodes if asked for anything but the order they were built in
+  trie->prof_depth = 0;
+  if (opts && opts->layout != LCT_LAYOUT_DFS &&
+      lct_relayout_profile(trie, opts->layout, opts->profile)) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie node buffer\n");
+    return -1;
+  }
+  if (opts && opts->profile && opts->layout == LCT_LAYOUT_DFS)
+    trie->prof_depth = profile_walk(trie, opts->profile, NULL, NULL);
+
+  // summarize the finished trie into the fast miss filter if asked to
+  if (opts && opts->filter_bits && build_filter(trie, opts->filter_bits)) {
+    lct_free(trie);
+    fprintf(stderr, "ERROR: failed to allocate trie fast miss filter\n");
+    return -1;
+  }
 
   return 0;
 }
@@ -223,22 +1134,115 @@ void lct_free(lct_t *trie) {
 
   // don't free the external subnet array.
   // that's under outside control.
-  free(trie->root);
-  free(trie->bases);
+  lct_mem_free(&trie->alloc, trie->root);
+  lct_mem_free(&trie->alloc, trie->chain);
+  lct_mem_free(&trie->alloc, trie->chainoff);
+  lct_mem_free(&trie->alloc, trie->hot);
+  lct_mem_free(&trie->alloc, trie->bases);
+  lct_mem_free(&trie->alloc, trie->attrs);
+  lct_mem_free(&trie->alloc, trie->attr16);
+  lct_mem_free(&trie->alloc, trie->attr32);
+  lct_mem_free(&trie->alloc, trie->filter);
+  lct_mem_free(&trie->alloc, trie->filter_ids);
+  lct_mem_free(&trie->alloc, trie->asns);
+  lct_mem_free(&trie->alloc, trie->asn_off);
+  lct_mem_free(&trie->alloc, trie->asn_nets);
+  lct_mem_free(&trie->alloc, trie->cidr_off);
+  lct_mem_free(&trie->alloc, trie->asn_cidrs);
+  trie->filter = NULL;
+  trie->filter_ids = NULL;
+  trie->asns = NULL;
+  trie->nasns = 0;
+  trie->asn_off = NULL;
+  trie->asn_nets = NULL;
+  trie->cidr_off = NULL;
+  trie->asn_cidrs = NULL;
   trie->bases = NULL;
+  trie->attrs = NULL;
+  trie->attr16 = NULL;
+  trie->attr32 = NULL;
+  trie->acount = 0;
+  trie->hot = NULL;
+  trie->chainoff = NULL;
+  trie->chain = NULL;
   trie->root = NULL;
   trie->ncount = 0;
   trie->bcount = 0;
+  trie->scount = 0;
 }
 
-lct_subnet_t *lct_find(lct_t *trie, uint32_t key) {
+#if LCT_INSTRUMENT
+static __thread lct_instr_t instr;
+
+// tally up a finished lookup in the calling thread's counters
+static inline
+void instr_lookup(uint32_t steps, uint32_t chain, uint64_t *result) {
+  ++instr.lookups;
+  instr.steps += steps;
+  instr.prefix_steps += chain;
+  ++instr.steps_hist[(steps < LCT_INSTR_BITS) ? steps : LCT_INSTR_BITS - 1];
+  ++instr.chain_hist[(chain < LCT_INSTR_BITS) ? chain : LCT_INSTR_BITS - 1];
+  ++*result;
+}
+
+#define INSTR_STEP(n)                     (++(n))
+#define INSTR_LOOKUP(steps, chain, field) instr_lookup(steps, chain, &instr.field)
+#else
+#define INSTR_STEP(n)
+#define INSTR_LOOKUP(steps, chain, field)
+#endif
+
+int lct_instr_snapshot(lct_instr_t *out, int reset) {
+#if LCT_INSTRUMENT
+  if (out)
+    memcpy(out, &instr, sizeof(lct_instr_t));
+  if (reset)
+    memset(&instr, 0, sizeof(lct_instr_t));
+  return 0;
+#else
+  if (out)
+    memset(out, 0, sizeof(lct_instr_t));
+  return -1;
+#endif
+}
+
+// look a key up in the fast miss filter, returns 1 with the answer in idx
+// if the key's block is uniform, otherwise 0
+static inline
+int filter_find(const lct_t *trie, uint32_t key, uint32_t *idx) {
+  uint32_t blk = key >> (32 - trie->filter_bits);
+  const lct_filter_t *g = &trie->filter[blk >> 6];
+  uint64_t bit = 1ULL << (blk & 63);
+
+  if (!(g->uniform & bit))
+    return 0;
+
+  // the block's run is the last one started at or before it
+  *idx = trie->filter_ids[g->rank + __builtin_popcountll(g->runs & (bit | (bit - 1))) - 1];
+  return 1;
+}
+
+// shared by all of the lookup entry points so the traversal is inlined.
+// if bits isn't NULL, it's set to the number of leading key bits which
+// decided the result.  the traversal only looks at the bits up to the leaf,
+// and the leaf's base and prefixes only compare bits up to the base length,
+// since prefixes are always shorter than their bases.
+static inline
+uint32_t find_idx(lct_t *trie, uint32_t key, int *bits) {
   lct_node_t *node;
   int pos, branch, idx;
-  uint32_t bitmask, prep;
+  uint32_t bitmask, base, prep;
+#if LCT_INSTRUMENT
+  uint32_t steps = 0, chain = 0;
+#endif
 
-  // idiot check
-  if (!trie)
-    return NULL;
+  // uniform blocks are answered without going anywhere near the trie
+  if (trie->filter && filter_find(trie, key, &base)) {
+    if (bits)
+      *bits = trie->filter_bits;
+    INSTR_LOOKUP(0, 0, filter_hits);
+    return base;
+  }
 
   // Traverse the trie
   node = &trie->root[0];
@@ -250,20 +1254,477 @@ lct_subnet_t *lct_find(lct_t *trie, uint32_t key) {
     pos += branch + node->skip;
     branch = node->branch;
     idx = node->index;
+    INSTR_STEP(steps);
   }
 
   /* Was this a hit? */
-  bitmask = trie->nets[trie->bases[idx]].addr ^ key;
-  if (EXTRACT(0, trie->nets[trie->bases[idx]].len, bitmask) == 0)
-    return &trie->nets[trie->bases[idx]];
+  base = trie->bases[idx];
+  bitmask = LCT_HOT(trie)[base].addr ^ key;
+  if (bits)
+    *bits = (pos > LCT_HOT(trie)[base].len) ? pos : LCT_HOT(trie)[base].len;
+  if (PREFIX_MATCH(LCT_HOT(trie)[base].len, bitmask)) {
+    INSTR_LOOKUP(steps, chain, base_hits);
+    return base;
+  }
 
   /* If not, look in the prefix tree */
-  prep = trie->nets[trie->bases[idx]].prefix;
+  prep = LCT_HOT(trie)[base].prefix;
   while (prep != IP_PREFIX_NIL) {
-    if (EXTRACT(0, trie->nets[prep].len, bitmask) == 0)
-      return &trie->nets[prep];
-    prep = trie->nets[prep].prefix;
+    INSTR_STEP(chain);
+    if (PREFIX_MATCH(LCT_HOT(trie)[prep].len, bitmask)) {
+      INSTR_LOOKUP(steps, chain, prefix_hits);
+      return prep;
+    }
+    prep = LCT_HOT(trie)[prep].prefix;
+  }
+
+  INSTR_LOOKUP(steps, chain, misses);
+  return IP_PREFIX_NIL;
+}
+
+uint32_t lct_find_idx(lct_t *trie, uint32_t key) {
+  // idiot check
+  if (!trie)
+    return IP_PREFIX_NIL;
+
+  return find_idx(trie, key, NULL);
+}
+
+uint32_t lct_find_id(lct_t *trie, uint32_t key) {
+  uint32_t idx;
+
+  // idiot check
+  if (!trie || !trie->attrs)
+    return LCT_ATTR_NIL;
+
+  if (IP_PREFIX_NIL == (idx = find_idx(trie, key, NULL)))
+    return LCT_ATTR_NIL;
+  return trie->attr16 ? trie->attr16[idx] : trie->attr32[idx];
+}
+
+uint32_t lct_find_idx_block(lct_t *trie, uint32_t key, uint8_t len, int *uniform) {
+  uint32_t idx;
+  int bits;
+
+  // idiot check
+  if (!trie)
+    return IP_PREFIX_NIL;
+
+  // every key in the block gets the same result if it was decided by bits
+  // within the block's prefix
+  idx = find_idx(trie, key, &bits);
+  if (uniform)
+    *uniform = (bits <= len);
+
+  return idx;
+}
+
+lct_subnet_t *lct_find(lct_t *trie, uint32_t key) {
+  uint32_t idx;
+
+  // idiot check
+  if (!trie)
+    return NULL;
+
+  idx = find_idx(trie, key, NULL);
+  return (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+}
+
+int lct_find_all(lct_t *trie, uint32_t key, lct_subnet_t *out[], int max) {
+  uint32_t idx, i;
+  int num = 0;
+
+  // idiot check
+  if (!trie || !out || max <= 0)
+    return 0;
+
+  if (IP_PREFIX_NIL == (idx = find_idx(trie, key, NULL)))
+    return 0;
+
+  // every prefix of the most specific match contains the key as well
+  out[num++] = &trie->nets[idx];
+  if (trie->chain) {
+    for (i = trie->chainoff[idx]; i < trie->chainoff[idx + 1] && num < max; ++i)
+      out[num++] = &trie->nets[trie->chain[i]];
+  }
+  else {
+    // tries without the precomputed chains, such as NUMA replicas,
+    // have to walk the full prefixes through the subnet array
+    for (i = trie->nets[idx].fullprefix; i != IP_PREFIX_NIL && num < max;
+         i = trie->nets[i].fullprefix)
+      out[num++] = &trie->nets[i];
+  }
+
+  return num;
+}
+
+// position of an ASN in the index, or nasns if it isn't there
+static
+uint32_t asn_find(const lct_t *trie, uint32_t asn) {
+  uint32_t lo = 0, hi = trie->nasns, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (trie->asns[mid] < asn)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return (lo < trie->nasns && trie->asns[lo] == asn) ? lo : trie->nasns;
+}
+
+uint32_t lct_asn_subnets(const lct_t *trie, uint32_t asn, const uint32_t **idx) {
+  uint32_t a;
+
+  // idiot check
+  if (!trie || !idx || !trie->asns)
+    return 0;
+
+  if ((a = asn_find(trie, asn)) == trie->nasns)
+    return 0;
+
+  *idx = &trie->asn_nets[trie->asn_off[a]];
+  return trie->asn_off[a + 1] - trie->asn_off[a];
+}
+
+uint32_t lct_asn_cidrs(const lct_t *trie, uint32_t asn, const lct_cidr_t **cidrs) {
+  uint32_t a;
+
+  // idiot check
+  if (!trie || !cidrs || !trie->asns)
+    return 0;
+
+  if ((a = asn_find(trie, asn)) == trie->nasns)
+    return 0;
+
+  *cidrs = &trie->asn_cidrs[trie->cidr_off[a]];
+  return trie->cidr_off[a + 1] - trie->cidr_off[a];
+}
+
+// index of the first subnet sorting at or after addr/len according to
+// subnet_cmp, or scount if there is none
+static
+uint32_t lower_bound(const lct_t *trie, uint32_t addr, uint8_t len) {
+  uint32_t lo = 0, hi = trie->scount, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (LCT_HOT(trie)[mid].addr < addr ||
+        (LCT_HOT(trie)[mid].addr == addr && LCT_HOT(trie)[mid].len < len))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+// last address in a CIDR subnet
+static inline
+uint32_t subnet_last(uint32_t addr, uint8_t len) {
+  return addr | (uint32_t) (0xffffffffULL >> len);
+}
+
+lct_subnet_t *lct_range_begin(lct_range_t *it, const lct_t *trie,
+                              uint32_t addr, uint8_t len, int mode) {
+  if (!it || !trie || len > 32)
+    return NULL;
+
+  it->trie = trie;
+  it->len = len;
+  it->addr = addr & (uint32_t) ~(0xffffffffULL >> len);
+  it->last = subnet_last(it->addr, len);
+  it->mode = mode;
+
+  // the array is sorted by address and then length, so every subnet
+  // inside the range sits in one run starting at the range itself.
+  it->pos = lower_bound(trie, it->addr, len);
+
+  return lct_range_next(it);
+}
+
+lct_subnet_t *lct_range_next(lct_range_t *it) {
+  const lct_t *trie;
+  lct_subnet_t *s;
+  uint32_t fp, last;
+
+  if (!it || !it->trie)
+    return NULL;
+
+  trie = it->trie;
+  while (it->pos < trie->scount && trie->nets[it->pos].addr <= it->last) {
+    s = &trie->nets[it->pos++];
+
+    if (it->mode != LCT_RANGE_CHILDREN)
+      return s;
+
+    // the outermost subnets in the range are the ones without any
+    // prefixes of their own inside of the range
+    fp = s->fullprefix;
+    if (s->len > it->len && (fp == IP_PREFIX_NIL || trie->nets[fp].len <= it->len)) {
+      // hop over all of its descendants for the next call
+      last = subnet_last(s->addr, s->len);
+      it->pos = (last == UINT32_MAX) ? trie->scount : lower_bound(trie, last + 1, 0);
+      return s;
+    }
   }
 
   return NULL;
 }
+
+int lct_block_uniform(const lct_t *trie, uint32_t key, uint8_t len) {
+  uint32_t blk, idx;
+
+  if (!trie || len > 32)
+    return 0;
+
+  if (len == 32)
+    return 1;
+
+  // any subnet starting inside the block that's more specific than the
+  // block splits it up, anything less specific covers all of it
+  blk = (len == 0) ? 0 : key & ~(UINT32_MAX >> len);
+  idx = lower_bound(trie, blk, len + 1);
+  return idx >= trie->scount || LCT_HOT(trie)[idx].addr > subnet_last(blk, len);
+}
+
+// index of the first subnet at or after first starting past key, or scount
+// if there is none
+static
+uint32_t upper_bound(const lct_t *trie, uint32_t first, uint32_t key) {
+  uint32_t lo = first, hi = trie->scount, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (LCT_HOT(trie)[mid].addr <= key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+lct_subnet_t *lct_find_range(lct_t *trie, uint32_t key, uint32_t *lo, uint32_t *hi) {
+  uint32_t idx, next, prev, fp, first, last;
+
+  // idiot check
+  if (!trie || !lo || !hi)
+    return NULL;
+
+  idx = find_idx(trie, key, NULL);
+
+  // every subnet boundary changes the answer, since the subnets on either
+  // side of it can't both contain the address.  so the range ends right
+  // before the next subnet starting after the key, and at the end of the
+  // match.  the match's more specific subnets all sort right after it.
+  next = upper_bound(trie, (idx == IP_PREFIX_NIL) ? 0 : idx + 1, key);
+  last = (next < trie->scount) ? LCT_HOT(trie)[next].addr - 1 : UINT32_MAX;
+  if (idx != IP_PREFIX_NIL && subnet_last(LCT_HOT(trie)[idx].addr, LCT_HOT(trie)[idx].len) < last)
+    last = subnet_last(LCT_HOT(trie)[idx].addr, LCT_HOT(trie)[idx].len);
+
+  // it starts right after the outermost subnet ending before the key that
+  // isn't the match or one of its prefixes, or at the match itself.  the
+  // last subnet starting at or before the key is either the match, or in
+  // the outermost one's full prefix chain.
+  first = 0;
+  if (next > 0) {
+    prev = next - 1;
+    if (prev == idx) {
+      first = LCT_HOT(trie)[idx].addr;
+    }
+    else {
+      while ((fp = trie->nets[prev].fullprefix) != IP_PREFIX_NIL &&
+             !PREFIX_MATCH(trie->nets[fp].len, trie->nets[fp].addr ^ key))
+        prev = fp;
+      first = subnet_last(trie->nets[prev].addr, trie->nets[prev].len) + 1;
+    }
+  }
+
+  *lo = first;
+  *hi = last;
+  return (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+}
+
+// every level of the trie consumes at least a bit of the key
+#define MAX_DEPTH         33
+
+// a key in a batch along with its position in the caller's arrays
+typedef struct batch_key {
+  uint32_t key;
+  uint32_t pos;
+} batch_key_t;
+
+// traversal state on the way down to a leaf
+typedef struct batch_step {
+  uint32_t idx;         // index of the node's first child, or its base
+  int pos;              // key bits consumed so far, including the skip
+  int branch;           // branch bits of the node
+  int need;             // key bits that decided this node, its parent's
+                        // pos + branch
+} batch_step_t;
+
+// LSD radix sort on digits of the given width, ping-ponging between the
+// two buffers and ending up back in the first one.  the width has to split
+// 32 bits into an even number of passes.
+static
+void batch_sort(batch_key_t *keys, batch_key_t *tmp, uint32_t n, uint32_t *count,
+                int width) {
+  batch_key_t *src = keys, *dst = tmp, *swap;
+  uint32_t digits = 1 << width, mask = digits - 1;
+
+  for (int shift = 0; shift < 32; shift += width) {
+    memset(count, 0, digits * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; ++i)
+      ++count[(src[i].key >> shift) & mask];
+
+    for (uint32_t i = 0, sum = 0, c; i < digits; ++i) {
+      c = count[i];
+      count[i] = sum;
+      sum += c;
+    }
+
+    for (uint32_t i = 0; i < n; ++i)
+      dst[count[(src[i].key >> shift) & mask]++] = src[i];
+
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+}
+
+// sort the keys in sorted, which has room for 2 * n of them, and look
+// them up in order
+static
+void batch_find(lct_t *trie, const uint32_t *keys, lct_subnet_t **results,
+                uint32_t n, batch_key_t *sorted, uint32_t *count, int width) {
+  batch_step_t path[MAX_DEPTH + 1];
+  lct_node_t *node;
+  uint32_t key, prev = 0, walked = 0, diff, base, bitmask, prep, idx = IP_PREFIX_NIL, fidx;
+  int depth, common, valid = 0;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    sorted[i].key = keys[i];
+    sorted[i].pos = i;
+  }
+  batch_sort(sorted, sorted + n, n, count, width);
+
+  node = &trie->root[0];
+  path[0].idx = node->index;
+  path[0].pos = node->skip;
+  path[0].branch = node->branch;
+  path[0].need = 0;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    key = sorted[i].key;
+
+    // duplicates get the same answer
+    if (i > 0 && key == prev) {
+      results[sorted[i].pos] = (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+      continue;
+    }
+
+    // uniform blocks are answered by the filter, leaving the path and the
+    // last key walked down it as they were for the next key to pick up from
+    if (trie->filter && filter_find(trie, key, &fidx)) {
+      idx = fidx;
+      prev = key;
+      results[sorted[i].pos] = (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+      continue;
+    }
+
+    // back up to the deepest node on the last path that was chosen only
+    // by bits this key has in common with the last key walked down it,
+    // or start from the root if no key has been yet
+    diff = key ^ walked;
+    common = (valid && diff) ? __builtin_clz(diff) : 32;
+    depth = 0;
+    while (valid && depth < MAX_DEPTH && path[depth].branch != 0 &&
+           path[depth + 1].need <= common)
+      ++depth;
+
+    // and traverse the rest of the way down from there
+    while (path[depth].branch != 0) {
+      node = &trie->root[path[depth].idx + EXTRACT(path[depth].pos, path[depth].branch, key)];
+      path[depth + 1].need = path[depth].pos + path[depth].branch;
+      path[depth + 1].pos = path[depth + 1].need + node->skip;
+      path[depth + 1].branch = node->branch;
+      path[depth + 1].idx = node->index;
+      ++depth;
+    }
+
+    /* Was this a hit? */
+    base = trie->bases[path[depth].idx];
+    bitmask = LCT_HOT(trie)[base].addr ^ key;
+    idx = IP_PREFIX_NIL;
+    if (PREFIX_MATCH(LCT_HOT(trie)[base].len, bitmask)) {
+      idx = base;
+    }
+    else {
+      /* If not, look in the prefix tree */
+      prep = LCT_HOT(trie)[base].prefix;
+      while (prep != IP_PREFIX_NIL) {
+        if (PREFIX_MATCH(LCT_HOT(trie)[prep].len, bitmask)) {
+          idx = prep;
+          break;
+        }
+        prep = LCT_HOT(trie)[prep].prefix;
+      }
+    }
+
+    results[sorted[i].pos] = (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+    prev = walked = key;
+    valid = 1;
+  }
+}
+
+int lct_find_batch(lct_t *trie, const uint32_t *keys, lct_subnet_t **results,
+                   uint32_t n) {
+  batch_key_t *sorted;
+  uint32_t small[1 << 8], *count = small;
+  int width = 8;
+
+  // idiot check
+  if (!trie || !keys || !results)
+    return -1;
+
+  if (!n)
+    return 0;
+
+  // small batches, like the ones a pipeline worker gets, can't pay for
+  // clearing and summing 64k counters twice, so they take four passes
+  // over byte sized digits instead
+  if (n >= (1 << 16)) {
+    width = 16;
+    count = (uint32_t *) malloc((1 << 16) * sizeof(uint32_t));
+  }
+
+  sorted = (batch_key_t *) malloc(2 * n * sizeof(batch_key_t));
+  if (!sorted || !count) {
+    free(sorted);
+    if (count != small)
+      free(count);
+    return -1;
+  }
+
+  batch_find(trie, keys, results, n, sorted, count, width);
+
+  free(sorted);
+  if (count != small)
+    free(count);
+  return 0;
+}
+
+int lct_find_batch_buf(lct_t *trie, const uint32_t *keys, lct_subnet_t **results,
+                       uint32_t n, void *buf) {
+  uint32_t count[1 << 8];
+
+  // idiot check
+  if (!trie || !keys || !results || (n && !buf))
+    return -1;
+
+  if (n)
+    batch_find(trie, keys, results, n, (batch_key_t *) buf, count, 8);
+  return 0;
+}
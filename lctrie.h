@@ -6,6 +6,11 @@
 #include <stdint.h>
 
 #include "lctrie_ip.h"
+#include "lctrie_alloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* remove the first p bits from string */
 #define REMOVE(p, str)   ((str)<<(p)>>(p))
@@ -51,6 +56,53 @@ typedef struct lct_node {
 // Leave this structure unpacked so the compiler will memory align it
 // in a mannder that favors fast access over memory unit size.
 
+// Hot/cold split of the subnet array
+//
+// lct_find() only ever needs a subnet's address, prefix length, and prefix
+// index, but those share a 32 byte lct_subnet_t with the subnet info union.
+// With LCT_HOT_SPLIT enabled, lct_build() extracts those three fields into a
+// packed 12 byte array parallel to the subnet array, so nearly three times as
+// many subnets fit in a cache line while matching bases and walking prefixes.
+// The lookup only touches the hot array, and callers resolve the resulting
+// index against the cold subnet array afterwards.
+#ifndef LCT_HOT_SPLIT
+#define LCT_HOT_SPLIT     1
+#endif
+
+typedef struct lct_hot {
+  uint32_t addr;          // subnet address
+  uint32_t prefix;        // index to our next highest non-full prefix
+  uint8_t len;            // CIDR address prefix length
+} lct_hot_t;
+
+// Fast miss filter
+//
+// An optional summary of the trie at a fixed block granularity, built with
+// the filter_bits option.  Every /filter_bits block of the address space
+// resolving to a single answer, one subnet or no subnet at all, has its
+// uniform bit set, and every run of consecutive uniform blocks with the
+// same answer shares one entry in an array of results.  Lookups check the
+// filter before the trie, so scans through unrouted and bogon space, and
+// addresses inside big prefixes, cost a load from the filter and one from
+// the results instead of a dependent walk down the trie and prefix chain.
+// The bitmaps take 3 bits per block, 6MB for /24 blocks and 384kB for /20
+// blocks, and each run of results takes 4 bytes.
+typedef struct lct_filter {
+  uint64_t uniform;       // blocks of the group with a single answer
+  uint64_t runs;          // uniform blocks starting a new run of results
+  uint32_t rank;          // runs started in every group before this one
+} lct_filter_t;
+
+// smallest and largest filter block prefix lengths
+#define LCT_MIN_FILTER_BITS   6
+#define LCT_MAX_FILTER_BITS   24
+
+// a bare CIDR block
+typedef struct lct_cidr {
+  uint32_t addr;
+  uint8_t len;
+} lct_cidr_t;
+
 // The size of the the trie is going to be
 // 2 * number of bases stored with nulls
 // sparsely mixed amongst the trie levels.
@@ -61,14 +113,142 @@ typedef struct lct_node {
 typedef struct lct {
   uint32_t ncount;    // number of trie nodes, will always be <= 2 * pcount
   uint32_t bcount;    // number of trie base subnet leaves
+  uint32_t scount;    // number of subnets in the nets array
   uint8_t shortest;   // shortest base subnet length (just for stats)
+  uint32_t gen;       // unique generation number of this build, never 0
 
   uint32_t *bases;    // array of indexes in the base array to indexes
                       // into the subnet info data array.
   lct_subnet_t *nets; // pointer to a sorted and prefixed array of subnets
+  lct_hot_t *hot;     // lookup fields of nets, NULL without LCT_HOT_SPLIT
   lct_node_t *root;   // pointer to the root of the trie node tree
+
+  // every subnet's chain of covering prefixes, full prefixes included,
+  // from most to least specific.  subnet i's chain is stored at
+  // chain[chainoff[i]] up to chain[chainoff[i + 1]].
+  uint32_t *chainoff;
+  uint32_t *chain;
+
+  lct_allocator_t alloc;  // allocator backing the arrays above, save nets
+
+  // level compression the trie was built with, and the average number of
+  // nodes a uniformly random lookup walks down to reach its leaf
+  uint8_t root_branch;
+  uint8_t fill;
+  double exp_depth;
+  double prof_depth;  // average nodes walked by the build profile's keys,
+                      // 0 without a profile
+
+  // every distinct subnet info value in the nets array, and the id of each
+  // subnet's info in there.  the ids are 16 bits wide when they fit, so
+  // one of attr16 and attr32 is set.  all NULL unless built with attrs.
+  lct_subnet_info_t *attrs;
+  uint32_t acount;
+  uint16_t *attr16;
+  uint32_t *attr32;
+
+  // the fast miss filter's groups of 64 blocks, and the answer of each run
+  // of uniform blocks.  NULL unless built with filter_bits.
+  lct_filter_t *filter;
+  uint32_t *filter_ids;
+  uint32_t filter_runs;
+  uint8_t filter_bits;
+
+  // ASN inverted index, every ASN with BGP subnets in ascending order, the
+  // indexes of its subnets, and the fewest CIDR blocks covering them.  the
+  // subnets of asns[i] are asn_nets[asn_off[i]] up to asn_nets[asn_off[i + 1]]
+  // in sorted order, and its blocks are asn_cidrs[cidr_off[i]] up to
+  // asn_cidrs[cidr_off[i + 1]].  all NULL unless built with asn_index.
+  uint32_t *asns;
+  uint32_t nasns;
+  uint32_t *asn_off;
+  uint32_t *asn_nets;
+  uint32_t *cidr_off;
+  lct_cidr_t *asn_cidrs;
 } lct_t;
 
+// nil attribute id canary
+#define LCT_ATTR_NIL    UINT32_MAX
+
+// widest root node a build may be asked for
+#define LCT_MAX_ROOT_BRANCH   24
+
+// Traffic profile
+//
+// Sampled lookup keys the build shapes the trie around.  Each key counts
+// weights[i] times, or once with no weights, so a sampled trace can be
+// passed as is, and a histogram of keys as its distinct keys and their
+// counts.  Counters collected with lct_acct can be turned into one with
+// lct_acct_profile().
+//
+// Sub-tries getting more than their share of the profile for the number
+// of bases in them are given wider branches, dropping the fill factor they
+// have to meet by up to LCT_PROFILE_MAX_WIDEN times, so their lookups walk
+// through fewer levels.  Sub-tries getting their share or less keep the
+// normal fill factor, since raising it only made them deeper.  With the
+// LCT_LAYOUT_HOT layout the blocks of nodes the profile walks through most
+// go first in the node array, so the hot paths share lines and pages.
+typedef struct lct_profile {
+  uint32_t *keys;       // host byte ordering
+  uint64_t *weights;    // NULL for a weight of one each
+  uint32_t n;
+} lct_profile_t;
+
+// most a profile may drop the fill factor of a hot sub-trie by
+#define LCT_PROFILE_MAX_WIDEN   8
+
+// optional trie build parameters, zero initialize for the defaults
+typedef struct lct_opts {
+  const lct_allocator_t *alloc; // allocator for the trie's interior arrays,
+                                // NULL for libc malloc()
+  uint8_t root_branch;          // branch bits of the root node, 0 for the
+                                // default, up to LCT_MAX_ROOT_BRANCH
+  uint8_t fill;                 // percentage of a node's slots that must be
+                                // used to branch wider, 0 for the default
+  size_t budget;                // bytes allowed for the nodes and bases, 0
+                                // for no limit.  picks the root branch and
+                                // fill giving the shallowest trie that fits,
+                                // overriding the two above.
+  int attrs;                    // intern the subnet info values into an
+                                // attribute table for lct_find_id()
+  uint8_t filter_bits;          // block prefix length of the fast miss
+                                // filter, LCT_MIN_FILTER_BITS up to
+                                // LCT_MAX_FILTER_BITS, or 0 for none
+  uint8_t layout;               // order of the node array, one of the
+                                // LCT_LAYOUT_* values below
+  const lct_profile_t *profile; // lookup traffic to shape the trie around,
+                                // NULL for none
+  int asn_index;                // index the BGP subnets by ASN for
+                                // lct_asn_subnets() and lct_asn_cidrs()
+} lct_opts_t;
+
+// Node layouts
+//
+// The children of a node always sit together in one block of the node
+// array, but the blocks themselves can go in any order.  lct_build() hands
+// them out depth first, so a block's first child block follows right after
+// it, while the child blocks of its other children come after the whole
+// subtree of the first one.  The root block always comes first.
+//
+// LCT_LAYOUT_DFS  depth first, the order the build allocates the blocks in
+// LCT_LAYOUT_BFS  breadth first, all of each level of the trie together
+// LCT_LAYOUT_VEB  van Emde Boas, for each subtree under the root block, the
+//                 top half of it by height followed by each of the bottom
+//                 halves hanging off of it, laid out the same way
+//                 recursively
+// LCT_LAYOUT_HOT  busiest blocks first by the lookups of a traffic profile,
+//                 and the rest depth first, only with a profile
+//
+// With the default wide root most lookups only reach a block or two past
+// the root, and the depth first order already keeps every subtree under a
+// root slot together.  The other layouts are there to measure against it,
+// with bench_mem, on narrower and deeper tries.
+#define LCT_LAYOUT_DFS    0
+#define LCT_LAYOUT_BFS    1
+#define LCT_LAYOUT_VEB    2
+#define LCT_LAYOUT_HOT    3
+#define LCT_LAYOUT_MAX    LCT_LAYOUT_HOT
+
 // lifecycle functions
 //
 // we store pointers to the subnet passed in here, so the subnet array must
@@ -76,15 +256,168 @@ typedef struct lct {
 // free the trie before doing so and recreate it afterwards.  This doesn't bode
 // well for a large number of dynamic updates, but keeping updates to a minimum
 // and potentially double buffering the data can reduce latency for these
-// events.
+// events.  a failed build leaves the trie empty, so it's always safe to
+// lct_free() afterwards.
 extern int lct_build(lct_t *trie, lct_subnet_t *subnets, uint32_t size);
+extern int lct_build_opts(lct_t *trie, lct_subnet_t *subnets, uint32_t size,
+                          const lct_opts_t *opts);
 extern void lct_free(lct_t *trie);
 
+// reorder the node blocks of a built trie into one of the LCT_LAYOUT_*
+// layouts, rewriting the child indexes to match.  every lookup gets the
+// same answer as before, but the node array is replaced, so this must not
+// run while anything else is using the trie.
+// returns 0 on success, or -1 if the layout is unknown or the new node
+// array can't be allocated, leaving the trie as it was.
+extern int lct_relayout(lct_t *trie, int layout);
+
+// the same, with the traffic profile LCT_LAYOUT_HOT orders the blocks by.
+// also sets prof_depth for the profile.
+extern int lct_relayout_profile(lct_t *trie, int layout, const lct_profile_t *profile);
+
 // trie search function
 // return the IP subnet corresponding to the element,
 // otherwise return NULL if not found
 // key must be provided in host byte ordering
 extern lct_subnet_t *lct_find(lct_t *trie, uint32_t key);
 
+// trie search function returning the index of the matching subnet
+// in trie->nets, otherwise return IP_PREFIX_NIL if not found
+// key must be provided in host byte ordering
+extern uint32_t lct_find_idx(lct_t *trie, uint32_t key);
+
+// trie search function returning the id of the matching subnet's info in
+// trie->attrs, otherwise return LCT_ATTR_NIL if not found or the trie was
+// built without attrs.  callers only after the type or ASN of an address
+// touch the small attribute table instead of the subnet array, and can
+// tally up traffic straight into an array of trie->acount counters.
+// key must be provided in host byte ordering
+extern uint32_t lct_find_id(lct_t *trie, uint32_t key);
+
+// trie search function returning the index of the matching subnet like
+// lct_find_idx(), which also cheaply determines whether every address in
+// the CIDR block of length len containing the key is certain to get the same
+// result.  uniform is set to 1 if so, otherwise 0.  unlike
+// lct_block_uniform(), this may miss some blocks that are uniform.
+// key must be provided in host byte ordering
+extern uint32_t lct_find_idx_block(lct_t *trie, uint32_t key, uint8_t len, int *uniform);
+
+// trie search function returning every subnet containing the key, from the
+// most specific match out through its full chain of covering prefixes,
+// including the full prefixes lct_find() skips over.
+// fills in up to max subnets and returns the number filled in
+// key must be provided in host byte ordering
+extern int lct_find_all(lct_t *trie, uint32_t key, lct_subnet_t *out[], int max);
+
+// trie search function returning the matching subnet like lct_find(), which
+// also sets lo and hi to the widest range of addresses around the key that
+// all get the same answer, so sequential scans can skip looking up the rest
+// of the range.  that's the matching subnet minus its more specific
+// subnets, or the gap between subnets on a miss.
+// key, lo, and hi are all in host byte ordering
+extern lct_subnet_t *lct_find_range(lct_t *trie, uint32_t key, uint32_t *lo, uint32_t *hi);
+
+// reverse lookup of every BGP subnet announced by an ASN.  points idx at
+// the sorted indexes into trie->nets of its subnets, and returns how many
+// there are, 0 if there are none or the trie was built without asn_index.
+extern uint32_t lct_asn_subnets(const lct_t *trie, uint32_t asn, const uint32_t **idx);
+
+// reverse lookup of the fewest CIDR blocks covering exactly the addresses
+// of every BGP subnet announced by an ASN, with the subnets inside of
+// others dropped and sibling blocks merged, ready to push to a filter.
+// more specific subnets of other ASNs inside of them aren't carved out.
+// points cidrs at the blocks in address order, and returns how many there
+// are, 0 if there are none or the trie was built without asn_index.
+extern uint32_t lct_asn_cidrs(const lct_t *trie, uint32_t asn, const lct_cidr_t **cidrs);
+
+// batch trie search function for large offline jobs
+// looks up n keys, storing the subnet matching keys[i] in results[i], or NULL
+// if not found.  the keys are radix sorted first so that neighboring keys
+// can pick the traversal up where the previous key's path splits off,
+// instead of starting over from the root.
+// returns 0 on success, negative if the sort buffers can't be allocated.
+// keys must be provided in host byte ordering
+extern int lct_find_batch(lct_t *trie, const uint32_t *keys, lct_subnet_t **results,
+                          uint32_t n);
+
+// bytes of sort buffer lct_find_batch_buf() needs for n keys
+#define LCT_BATCH_BUF_BYTES(n)  (4 * (size_t) (n) * sizeof(uint32_t))
+
+// lct_find_batch() sorting in the caller's buffer of LCT_BATCH_BUF_BYTES(n)
+// bytes instead of allocating its own, for callers running many small
+// batches, like the pipeline workers, that can't afford a malloc() apiece.
+// the buffer must be 4 byte aligned.  returns 0 on success.
+extern int lct_find_batch_buf(lct_t *trie, const uint32_t *keys, lct_subnet_t **results,
+                              uint32_t n, void *buf);
+
+// does every address in the CIDR block of length len containing key
+// resolve to the same lookup result?  returns 1 if so, otherwise 0.
+// key must be provided in host byte ordering
+extern int lct_block_uniform(const lct_t *trie, uint32_t key, uint8_t len);
+
+// lookup instrumentation
+//
+// build the library with LCT_INSTRUMENT set to 1 to have every lookup count
+// the work it does in per thread counters, otherwise the counting compiles
+// down to nothing.  the histograms tell apart slow lookups caused by deep
+// traversals from those caused by long prefix chain walks.
+#ifndef LCT_INSTRUMENT
+#define LCT_INSTRUMENT    0
+#endif
+
+#define LCT_INSTR_BITS    33  // 0 through 32 steps
+
+typedef struct lct_instr {
+  uint64_t lookups;       // lookups made
+  uint64_t steps;         // trie nodes traversed below the root
+  uint64_t base_hits;     // lookups matching the base of their leaf
+  uint64_t prefix_steps;  // prefixes checked walking the prefix chain
+  uint64_t prefix_hits;   // lookups matching a prefix of their leaf
+  uint64_t misses;        // lookups matching nothing at all
+  uint64_t filter_hits;   // lookups answered by the fast miss filter
+  uint64_t steps_hist[LCT_INSTR_BITS];  // lookups by traversal steps
+  uint64_t chain_hist[LCT_INSTR_BITS];  // lookups by prefix chain steps
+} lct_instr_t;
+
+// copy out the calling thread's lookup counters, and zero them if reset is
+// set.  returns -1 if the library was built without instrumentation.
+extern int lct_instr_snapshot(lct_instr_t *out, int reset);
+
+// subnet range enumeration
+//
+// walks every subnet contained in a CIDR range in sorted order without
+// allocating anything.  the iterator lives on the caller's stack:
+//
+//   lct_range_t it;
+//   for (s = lct_range_begin(&it, trie, addr, len, LCT_RANGE_ALL); s;
+//        s = lct_range_next(&it))
+//
+// LCT_RANGE_ALL returns every subnet in the range, including a subnet
+// matching the range exactly.  LCT_RANGE_CHILDREN returns only the
+// outermost subnets inside of the range, skipping over their descendants.
+#define LCT_RANGE_ALL       0
+#define LCT_RANGE_CHILDREN  1
+
+typedef struct lct_range {
+  const lct_t *trie;
+  uint32_t addr;          // first address of the range
+  uint32_t last;          // last address of the range
+  uint8_t len;            // CIDR prefix length of the range
+  int mode;               // LCT_RANGE_ALL or LCT_RANGE_CHILDREN
+  uint32_t pos;           // index of the next subnet to consider
+} lct_range_t;
+
+// start iterating over the range, returning the first subnet in it
+// or NULL if there are none.  addr must be in host byte ordering
+extern lct_subnet_t *lct_range_begin(lct_range_t *it, const lct_t *trie,
+                                     uint32_t addr, uint8_t len, int mode);
+
+// return the next subnet in the range or NULL once it's exhausted
+extern lct_subnet_t *lct_range_next(lct_range_t *it);
+
+#ifdef __cplusplus
+}
+#endif
+
 // end #ifndef guard
 #endif
@@ -0,0 +1,308 @@
+#ifndef __LC_TRIE_HPP__
+#define __LC_TRIE_HPP__
+// begin #ifndef guard
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "lctrie.h"
+
+// C++17 front end
+//
+// lct_find() is behind a call into lctrie.c, and it has to read the shape
+// of the root node out of the trie on every lookup.  The templates here
+// wrap the same data structures, built by the same C code, but inline the
+// lookup into the caller with the root branch and whether to walk the
+// prefix chain fixed at compile time, so the first level of the traversal
+// is a shift and an add off the start of the node array.
+//
+// Trie<KeyT, RootBranch, ResolvePrefixes> owns its subnets and the C trie
+// built over them, and frees both when it goes out of scope.  The C trie is
+// still there for the rest of the C API through get().
+//
+// StaticTable<V, N> is for small tables known at compile time, such as the
+// RFC special ranges.  It's built entirely by the compiler into the sorted
+// address intervals sharing a single answer, so a lookup is one binary
+// search and the whole table lives in read only data.
+
+namespace lctrie {
+
+// how a key type turns into the host byte ordered address the trie takes
+template <typename KeyT>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<uint32_t> {
+  static constexpr uint32_t to_host(uint32_t key) noexcept { return key; }
+};
+
+// straight out of a socket address, in network byte ordering
+template <>
+struct KeyTraits<in_addr> {
+  static uint32_t to_host(in_addr key) noexcept { return ntohl(key.s_addr); }
+};
+
+// does the address xor'd with a subnet's come out zero over the first len
+// bits?  shifted in 64 bits so that a /0 default route matches everything.
+constexpr bool prefix_match(uint8_t len, uint32_t diff) noexcept {
+  return ((uint64_t) diff >> (32 - len)) == 0;
+}
+
+// mask, sort, dedup, and link up a subnet array ready for a build, the
+// same as lctrie_test does
+inline void prepare(std::vector<lct_subnet_t> &subnets) {
+  std::vector<lct_ip_stats_t> stats;
+
+  subnet_mask(subnets.data(), subnets.size());
+  qsort(subnets.data(), subnets.size(), sizeof(lct_subnet_t), subnet_cmp);
+  subnets.resize(subnets.size() - subnet_dedup(subnets.data(), subnets.size()));
+
+  stats.resize(subnets.size());
+  subnet_prefix(subnets.data(), stats.data(), subnets.size());
+}
+
+template <typename KeyT = uint32_t, int RootBranch = 16, bool ResolvePrefixes = true>
+class Trie {
+  static_assert(RootBranch >= 1 && RootBranch <= LCT_MAX_ROOT_BRANCH,
+                "root branch out of range");
+
+ public:
+  static constexpr int root_branch = RootBranch;
+  static constexpr bool resolve_prefixes = ResolvePrefixes;
+
+  // mask, sort, dedup, and link up the subnets, then build the trie over
+  // them with the root branch forced to RootBranch.  a budget in opts
+  // would pick its own root branch, so it's ignored.  throws
+  // std::bad_alloc if the build runs out of memory, and
+  // std::invalid_argument if the table is too small to branch RootBranch
+  // bits wide at the root, which takes at least three base subnets.
+  explicit Trie(std::vector<lct_subnet_t> subnets, lct_opts_t opts = lct_opts_t())
+      : subnets_(std::move(subnets)) {
+    if (subnets_.empty())
+      throw std::invalid_argument("lctrie::Trie: no subnets");
+    prepare(subnets_);
+
+    opts.root_branch = RootBranch;
+    opts.budget = 0;
+    if (lct_build_opts(&trie_, subnets_.data(), subnets_.size(), &opts))
+      throw std::bad_alloc();
+
+    // children of the root always start right after it
+    if (trie_.root[0].branch != RootBranch || trie_.root[0].index != 1) {
+      lct_free(&trie_);
+      throw std::invalid_argument("lctrie::Trie: too few bases for the root branch");
+    }
+    built_ = true;
+  }
+
+  ~Trie() {
+    if (built_)
+      lct_free(&trie_);
+  }
+
+  // the trie points into the subnets, and moving a vector keeps its buffer
+  Trie(Trie &&other) noexcept
+      : subnets_(std::move(other.subnets_)), trie_(other.trie_), built_(other.built_) {
+    other.built_ = false;
+  }
+
+  Trie &operator=(Trie &&other) noexcept {
+    if (this != &other) {
+      if (built_)
+        lct_free(&trie_);
+      subnets_ = std::move(other.subnets_);
+      trie_ = other.trie_;
+      built_ = other.built_;
+      other.built_ = false;
+    }
+    return *this;
+  }
+
+  Trie(const Trie &) = delete;
+  Trie &operator=(const Trie &) = delete;
+
+  // index of the longest matching subnet, or IP_PREFIX_NIL.  without
+  // ResolvePrefixes only the base subnet at the end of the traversal is
+  // matched, which is all there is to match in tables without nesting.
+  uint32_t find_idx(KeyT k) const noexcept {
+    const uint32_t key = KeyTraits<KeyT>::to_host(k);
+    const lct_node_t *node = &trie_.root[1 + (key >> (32 - RootBranch))];
+    int pos = RootBranch + node->skip;
+    int branch = node->branch;
+    uint32_t idx = node->index;
+    uint32_t base, bitmask, prep;
+
+    while (branch != 0) {
+      node = &trie_.root[idx + EXTRACT(pos, branch, key)];
+      pos += branch + node->skip;
+      branch = node->branch;
+      idx = node->index;
+    }
+
+    base = trie_.bases[idx];
+    bitmask = hot()[base].addr ^ key;
+    if (prefix_match(hot()[base].len, bitmask))
+      return base;
+
+    if (ResolvePrefixes) {
+      for (prep = hot()[base].prefix; prep != IP_PREFIX_NIL; prep = hot()[prep].prefix) {
+        if (prefix_match(hot()[prep].len, bitmask))
+          return prep;
+      }
+    }
+
+    return IP_PREFIX_NIL;
+  }
+
+  // the longest matching subnet, or nullptr
+  const lct_subnet_t *find(KeyT key) const noexcept {
+    uint32_t idx = find_idx(key);
+    return (idx != IP_PREFIX_NIL) ? &subnets_[idx] : nullptr;
+  }
+
+  const lct_subnet_t *operator()(KeyT key) const noexcept { return find(key); }
+
+  // the prepared subnets the indexes refer to
+  const std::vector<lct_subnet_t> &subnets() const noexcept { return subnets_; }
+  size_t size() const noexcept { return subnets_.size(); }
+
+  // the C trie, for the rest of the C API
+  lct_t *get() noexcept { return &trie_; }
+  const lct_t *get() const noexcept { return &trie_; }
+
+ private:
+#if LCT_HOT_SPLIT
+  const lct_hot_t *hot() const noexcept { return trie_.hot; }
+#else
+  const lct_subnet_t *hot() const noexcept { return trie_.nets; }
+#endif
+
+  std::vector<lct_subnet_t> subnets_;
+  lct_t trie_ = {};
+  bool built_ = false;
+};
+
+// a subnet of a static table along with its answer
+template <typename V>
+struct StaticEntry {
+  uint32_t addr;
+  uint8_t len;
+  V value;
+};
+
+template <typename V, size_t N>
+class StaticTable {
+  static_assert(N >= 1 && N <= 1024, "static tables are for small tables");
+
+ public:
+  using entry_type = StaticEntry<V>;
+
+  // the longest prefix match of every interval is worked out the slow way,
+  // O(N^2), since it's the compiler doing the work.  duplicate subnets
+  // resolve to the first one given, like subnet_dedup().
+  constexpr explicit StaticTable(const entry_type (&entries)[N]) {
+    uint32_t points[2 * N + 1] = {}, p = 0, tmp = 0, ans = 0;
+    size_t npoints = 0, i = 0, j = 0;
+    int best = -1;
+
+    for (i = 0; i < N; ++i) {
+      entries_[i] = entries[i];
+      entries_[i].addr &= mask(entries[i].len);
+    }
+
+    // every subnet starts an interval, and so does the address after it
+    points[npoints++] = 0;
+    for (i = 0; i < N; ++i) {
+      points[npoints++] = entries_[i].addr;
+      if ((entries_[i].addr | ~mask(entries_[i].len)) != UINT32_MAX)
+        points[npoints++] = (entries_[i].addr | ~mask(entries_[i].len)) + 1;
+    }
+
+    for (i = 1; i < npoints; ++i) {
+      tmp = points[i];
+      for (j = i; j > 0 && points[j - 1] > tmp; --j)
+        points[j] = points[j - 1];
+      points[j] = tmp;
+    }
+
+    // answer each interval, folding neighbors with the same answer
+    for (i = 0; i < npoints; ++i) {
+      p = points[i];
+      if (count_ && starts_[count_ - 1] == p)
+        continue;
+
+      best = -1;
+      for (j = 0; j < N; ++j) {
+        if (prefix_match(entries_[j].len, p ^ entries_[j].addr) &&
+            (best < 0 || entries_[j].len > entries_[best].len))
+          best = (int) j;
+      }
+
+      ans = (best < 0) ? IP_PREFIX_NIL : (uint32_t) best;
+      if (count_ && answers_[count_ - 1] == ans)
+        continue;
+      starts_[count_] = p;
+      answers_[count_] = ans;
+      ++count_;
+    }
+  }
+
+  // index into entries() of the longest match, or IP_PREFIX_NIL
+  template <typename KeyT = uint32_t>
+  constexpr uint32_t find_idx(KeyT k) const noexcept {
+    const uint32_t key = KeyTraits<KeyT>::to_host(k);
+    size_t lo = 0, hi = count_, mid = 0;
+
+    // the last interval starting at or before the key, the first always
+    // starts at 0
+    while (hi - lo > 1) {
+      mid = lo + (hi - lo) / 2;
+      if (starts_[mid] <= key)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    return answers_[lo];
+  }
+
+  template <typename KeyT = uint32_t>
+  constexpr const V *find(KeyT key) const noexcept {
+    uint32_t idx = find_idx(key);
+    return (idx != IP_PREFIX_NIL) ? &entries_[idx].value : nullptr;
+  }
+
+  constexpr const entry_type *entries() const noexcept { return entries_; }
+  constexpr size_t size() const noexcept { return N; }
+
+  // number of distinct intervals the address space was cut into
+  constexpr size_t intervals() const noexcept { return count_; }
+
+ private:
+  static constexpr uint32_t mask(uint8_t len) noexcept {
+    return len ? ~(uint32_t) 0 << (32 - len) : 0;
+  }
+
+  entry_type entries_[N] = {};
+  uint32_t starts_[2 * N + 1] = {};
+  uint32_t answers_[2 * N + 1] = {};
+  size_t count_ = 0;
+};
+
+// constexpr auto t = lctrie::make_static_table<int>({{0x0a000000, 8, 1}, ...});
+template <typename V, size_t N>
+constexpr StaticTable<V, N> make_static_table(const StaticEntry<V> (&entries)[N]) {
+  return StaticTable<V, N>(entries);
+}
+
+}  // namespace lctrie
+
+// end #ifndef guard
+#endif
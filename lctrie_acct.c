@@ -0,0 +1,218 @@
+#include "lctrie_acct.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ACCT_CACHE_LINE 64
+
+int lct_acct_init(lct_acct_t *acct, const lct_t *trie, uint32_t nthreads) {
+  void *counters;
+  size_t size;
+
+  if (!acct || !trie || !trie->scount || !nthreads)
+    return -1;
+
+  acct->trie = trie;
+  acct->nthreads = nthreads;
+  acct->nslots = trie->scount + 1;
+
+  if (!(acct->slots = (lct_counter_t **) calloc(nthreads, sizeof(lct_counter_t *)))) {
+    fprintf(stderr, "ERROR: failed to allocate accounting slots\n");
+    return -1;
+  }
+
+  // each thread's counters start on a cache line boundary and are padded
+  // out to a whole number of lines, so no two threads share a line
+  size = acct->nslots * sizeof(lct_counter_t);
+  size = (size + ACCT_CACHE_LINE - 1) & ~((size_t) ACCT_CACHE_LINE - 1);
+  for (uint32_t i = 0; i < nthreads; ++i) {
+    if (posix_memalign(&counters, ACCT_CACHE_LINE, size)) {
+      fprintf(stderr, "ERROR: failed to allocate accounting counters\n");
+      lct_acct_free(acct);
+      return -1;
+    }
+    memset(counters, 0, size);
+    acct->slots[i] = (lct_counter_t *) counters;
+  }
+
+  return 0;
+}
+
+void lct_acct_free(lct_acct_t *acct) {
+  if (!acct || !acct->slots)
+    return;
+
+  for (uint32_t i = 0; i < acct->nthreads; ++i)
+    free(acct->slots[i]);
+  free(acct->slots);
+  acct->slots = NULL;
+  acct->nthreads = 0;
+  acct->nslots = 0;
+}
+
+void lct_acct_reset(lct_acct_t *acct) {
+  if (!acct || !acct->slots)
+    return;
+
+  for (uint32_t i = 0; i < acct->nthreads; ++i)
+    memset(acct->slots[i], 0, acct->nslots * sizeof(lct_counter_t));
+}
+
+lct_subnet_t *lct_find_acct(lct_t *trie, lct_acct_t *acct, uint32_t thread,
+                            uint32_t key, uint32_t bytes) {
+  lct_counter_t *c;
+  uint32_t idx;
+
+  idx = lct_find_idx(trie, key);
+
+  // the relaxed atomics are just plain loads and stores, but they keep
+  // the merge from reading torn counters while we write them
+  if (acct && thread < acct->nthreads) {
+    c = &acct->slots[thread][(idx != IP_PREFIX_NIL) ? idx : acct->nslots - 1];
+    __atomic_store_n(&c->pkts, __atomic_load_n(&c->pkts, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&c->bytes, __atomic_load_n(&c->bytes, __ATOMIC_RELAXED) + bytes,
+                     __ATOMIC_RELAXED);
+  }
+
+  return (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+}
+
+void lct_acct_merge(const lct_acct_t *acct, lct_counter_t *merged) {
+  if (!acct || !merged)
+    return;
+
+  memset(merged, 0, acct->nslots * sizeof(lct_counter_t));
+  for (uint32_t i = 0; i < acct->nthreads; ++i) {
+    for (uint32_t j = 0; j < acct->nslots; ++j) {
+      merged[j].pkts += __atomic_load_n(&acct->slots[i][j].pkts, __ATOMIC_RELAXED);
+      merged[j].bytes += __atomic_load_n(&acct->slots[i][j].bytes, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+void lct_acct_by_type(const lct_acct_t *acct, const lct_counter_t *merged,
+                      lct_counter_t *out) {
+  uint32_t type;
+
+  if (!acct || !merged || !out)
+    return;
+
+  memset(out, 0, LCT_ACCT_NTYPES * sizeof(lct_counter_t));
+  for (uint32_t i = 0; i < acct->trie->scount; ++i) {
+    type = acct->trie->nets[i].info.type;
+    if (type >= LCT_ACCT_NTYPES)
+      type = IP_SUBNET_UNUSED;
+    out[type].pkts += merged[i].pkts;
+    out[type].bytes += merged[i].bytes;
+  }
+}
+
+static
+int asn_counter_cmp(const void *di, const void *dj) {
+  const lct_asn_counter_t *i = (const lct_asn_counter_t *) di;
+  const lct_asn_counter_t *j = (const lct_asn_counter_t *) dj;
+
+  if (i->asn < j->asn)
+    return -1;
+  else if (i->asn > j->asn)
+    return 1;
+  else
+    return 0;
+}
+
+int lct_acct_by_asn(const lct_acct_t *acct, const lct_counter_t *merged,
+                    lct_asn_counter_t **out) {
+  lct_asn_counter_t *asns;
+  int num = 0, nasn = 0;
+
+  if (!acct || !merged || !out)
+    return -1;
+
+  // gather up every BGP subnet with traffic, then sort and fold by ASN
+  if (!(asns = (lct_asn_counter_t *) malloc(acct->trie->scount * sizeof(lct_asn_counter_t))))
+    return -1;
+
+  for (uint32_t i = 0; i < acct->trie->scount; ++i) {
+    if (acct->trie->nets[i].info.type != IP_SUBNET_BGP || !merged[i].pkts)
+      continue;
+    asns[num].asn = acct->trie->nets[i].info.bgp.asn;
+    asns[num].count = merged[i];
+    ++num;
+  }
+
+  qsort(asns, num, sizeof(lct_asn_counter_t), asn_counter_cmp);
+  for (int i = 0; i < num; ++i) {
+    if (nasn && asns[nasn - 1].asn == asns[i].asn) {
+      asns[nasn - 1].count.pkts += asns[i].count.pkts;
+      asns[nasn - 1].count.bytes += asns[i].count.bytes;
+    }
+    else {
+      asns[nasn++] = asns[i];
+    }
+  }
+
+  *out = asns;
+  return nasn;
+}
+
+uint32_t lct_acct_top(const lct_acct_t *acct, const lct_counter_t *merged,
+                      uint32_t *idx, uint32_t n) {
+  uint32_t num = 0, j;
+
+  if (!acct || !merged || !idx || !n)
+    return 0;
+
+  // insertion into a short sorted list, n is expected to be small
+  for (uint32_t i = 0; i < acct->trie->scount; ++i) {
+    if (!merged[i].pkts || (num == n && merged[i].pkts <= merged[idx[num - 1]].pkts))
+      continue;
+
+    j = (num < n) ? num++ : num - 1;
+    for (; j > 0 && merged[idx[j - 1]].pkts < merged[i].pkts; --j)
+      idx[j] = idx[j - 1];
+    idx[j] = i;
+  }
+
+  return num;
+}
+
+int lct_acct_profile(const lct_acct_t *acct, const lct_counter_t *merged,
+                     lct_profile_t *out) {
+  lct_t *trie;
+  uint32_t n = 0, key, last, lo, hi;
+
+  if (!acct || !merged || !out)
+    return -1;
+
+  trie = (lct_t *) acct->trie;
+  out->n = 0;
+  out->keys = (uint32_t *) malloc(trie->scount * sizeof(uint32_t));
+  out->weights = (uint64_t *) malloc(trie->scount * sizeof(uint64_t));
+  if (!out->keys || !out->weights) {
+    fprintf(stderr, "ERROR: failed to allocate traffic profile\n");
+    free(out->keys);
+    free(out->weights);
+    out->keys = NULL;
+    out->weights = NULL;
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < trie->scount; ++i) {
+    if (!merged[i].pkts)
+      continue;
+
+    // hop over the more specific subnets at the start of this one until
+    // landing on an address it's the match for
+    key = trie->nets[i].addr;
+    last = key | (uint32_t) (0xffffffffULL >> trie->nets[i].len);
+    while (lct_find_range(trie, key, &lo, &hi) != &trie->nets[i] && hi < last)
+      key = hi + 1;
+
+    out->keys[n] = key;
+    out->weights[n++] = merged[i].pkts;
+  }
+
+  out->n = n;
+  return n;
+}
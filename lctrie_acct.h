@@ -0,0 +1,89 @@
+#ifndef __LC_TRIE_ACCT_H__
+#define __LC_TRIE_ACCT_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per subnet traffic accounting
+//
+// Every lookup thread gets its own slot of packet and byte counters indexed
+// by subnet, with one extra counter at the end for misses.  A thread only
+// ever writes its own slot, so the lookup path counts with plain loads and
+// stores and no locked instructions.  Merging sums all of the slots while
+// the lookup threads keep counting, so a snapshot is a consistent view of
+// each counter but not of all of them at one instant.
+
+// number of info.type values, IP_SUBNET_UNUSED through IP_SUBNET_USER
+#define LCT_ACCT_NTYPES   (IP_SUBNET_USER + 1)
+
+typedef struct lct_counter {
+  uint64_t pkts;
+  uint64_t bytes;
+} lct_counter_t;
+
+// counters rolled up to a BGP ASN
+typedef struct lct_asn_counter {
+  uint32_t asn;
+  lct_counter_t count;
+} lct_asn_counter_t;
+
+typedef struct lct_acct {
+  const lct_t *trie;
+  uint32_t nthreads;        // number of thread slots
+  uint32_t nslots;          // counters per slot, subnets plus the miss counter
+  lct_counter_t **slots;    // counters of each thread
+} lct_acct_t;
+
+// set up zeroed counters for nthreads lookup threads over a built trie
+extern int lct_acct_init(lct_acct_t *acct, const lct_t *trie, uint32_t nthreads);
+extern void lct_acct_free(lct_acct_t *acct);
+
+// zero every counter, must not race with lookups
+extern void lct_acct_reset(lct_acct_t *acct);
+
+// trie search function which also counts a packet of the given size
+// against the matching subnet in the calling thread's slot.  each thread
+// must pass its own thread number, less than nthreads.
+// key must be provided in host byte ordering
+extern lct_subnet_t *lct_find_acct(lct_t *trie, lct_acct_t *acct, uint32_t thread,
+                                   uint32_t key, uint32_t bytes);
+
+// sum every thread's slot into merged[nslots], misses land at the end
+extern void lct_acct_merge(const lct_acct_t *acct, lct_counter_t *merged);
+
+// roll merged counters up by subnet info type into out[LCT_ACCT_NTYPES]
+extern void lct_acct_by_type(const lct_acct_t *acct, const lct_counter_t *merged,
+                             lct_counter_t *out);
+
+// roll merged counters up by the ASN of BGP subnets.  returns the number of
+// ASNs with any traffic, sorted by ASN in a buffer the caller must free().
+// returns negative on failure.
+extern int lct_acct_by_asn(const lct_acct_t *acct, const lct_counter_t *merged,
+                           lct_asn_counter_t **out);
+
+// fill idx[] with the indexes of the n subnets with the most packets,
+// busiest first.  returns the number filled in.
+extern uint32_t lct_acct_top(const lct_acct_t *acct, const lct_counter_t *merged,
+                             uint32_t *idx, uint32_t n);
+
+// turn merged counters into a traffic profile for a rebuild, one key per
+// subnet with any packets weighted by its packet count.  each key is the
+// first address of its subnet that isn't inside a more specific subnet.
+// misses have nowhere to go and are left out.  returns the number of keys,
+// in buffers the caller must free(), or negative on failure.
+extern int lct_acct_profile(const lct_acct_t *acct, const lct_counter_t *merged,
+                            lct_profile_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
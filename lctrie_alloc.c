@@ -0,0 +1,163 @@
+#include "lctrie_alloc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+
+// 2MB huge pages on amd64
+#define HUGE_PAGE_SIZE    (2 * 1024 * 1024)
+#define SMALL_PAGE_SIZE   4096
+
+#define ROUNDUP(n, align) (((n) + (align) - 1) & ~((size_t) (align) - 1))
+
+// every block handed out is prefixed with its size so we can feed it back
+// to the realloc and free callbacks.  pad it out to a cache line to keep
+// the caller's memory aligned.
+typedef union lct_mem_hdr {
+  size_t size;
+  uint8_t pad[64];
+} lct_mem_hdr_t;
+
+static
+void *libc_malloc(void *ctx, size_t size) {
+  return malloc(size);
+}
+
+static
+void *libc_realloc(void *ctx, void *ptr, size_t oldsize, size_t size) {
+  return realloc(ptr, size);
+}
+
+static
+void libc_free(void *ctx, void *ptr, size_t size) {
+  free(ptr);
+}
+
+const lct_allocator_t lct_libc_allocator = {
+  libc_malloc,
+  libc_realloc,
+  libc_free,
+  NULL
+};
+
+// huge page mappings are always a multiple of the huge page size,
+// small mappings are a multiple of the regular page size
+static
+size_t huge_mapsize(size_t size) {
+  if (size < HUGE_PAGE_SIZE / 2)
+    return ROUNDUP(size, SMALL_PAGE_SIZE);
+
+  return ROUNDUP(size, HUGE_PAGE_SIZE);
+}
+
+static
+void *huge_malloc(void *ctx, size_t size) {
+  size_t mapsize = huge_mapsize(size);
+  uint8_t *p, *aligned;
+
+  if (mapsize < HUGE_PAGE_SIZE) {
+    p = mmap(NULL, mapsize, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+  }
+
+  // first try the reserved hugetlbfs pages
+  p = mmap(NULL, mapsize, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED)
+    return p;
+
+  // no luck, so fall back on transparent huge pages.  the kernel will only
+  // back huge page aligned ranges with them, so over-map by a huge page and
+  // trim the ends off to get the alignment.
+  p = mmap(NULL, mapsize + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+
+  aligned = (uint8_t *) ROUNDUP((uintptr_t) p, HUGE_PAGE_SIZE);
+  if (aligned > p)
+    munmap(p, aligned - p);
+  if (aligned < p + HUGE_PAGE_SIZE)
+    munmap(aligned + mapsize, (p + HUGE_PAGE_SIZE) - aligned);
+
+  // the advice is just a hint, we still have perfectly good memory without it
+  if (madvise(aligned, mapsize, MADV_HUGEPAGE))
+    fprintf(stderr, "WARNING: transparent huge pages unavailable: %s\n", strerror(errno));
+
+  return aligned;
+}
+
+static
+void huge_free(void *ctx, void *ptr, size_t size) {
+  if (ptr)
+    munmap(ptr, huge_mapsize(size));
+}
+
+static
+void *huge_realloc(void *ctx, void *ptr, size_t oldsize, size_t size) {
+  void *newptr;
+
+  // nothing to do if it still fits in the same number of pages
+  if (huge_mapsize(size) == huge_mapsize(oldsize))
+    return ptr;
+
+  if (!(newptr = huge_malloc(ctx, size)))
+    return NULL;
+
+  memcpy(newptr, ptr, (size < oldsize) ? size : oldsize);
+  huge_free(ctx, ptr, oldsize);
+  return newptr;
+}
+
+const lct_allocator_t lct_hugepage_allocator = {
+  huge_malloc,
+  huge_realloc,
+  huge_free,
+  NULL
+};
+
+void *lct_mem_alloc(const lct_allocator_t *alloc, size_t size) {
+  lct_mem_hdr_t *hdr;
+
+  if (!alloc)
+    alloc = &lct_libc_allocator;
+
+  if (!(hdr = alloc->malloc(alloc->ctx, sizeof(lct_mem_hdr_t) + size)))
+    return NULL;
+
+  hdr->size = sizeof(lct_mem_hdr_t) + size;
+  return hdr + 1;
+}
+
+void *lct_mem_realloc(const lct_allocator_t *alloc, void *ptr, size_t size) {
+  lct_mem_hdr_t *hdr;
+
+  if (!ptr)
+    return lct_mem_alloc(alloc, size);
+
+  if (!alloc)
+    alloc = &lct_libc_allocator;
+
+  hdr = (lct_mem_hdr_t *) ptr - 1;
+  if (!(hdr = alloc->realloc(alloc->ctx, hdr, hdr->size, sizeof(lct_mem_hdr_t) + size)))
+    return NULL;
+
+  hdr->size = sizeof(lct_mem_hdr_t) + size;
+  return hdr + 1;
+}
+
+void lct_mem_free(const lct_allocator_t *alloc, void *ptr) {
+  lct_mem_hdr_t *hdr;
+
+  if (!ptr)
+    return;
+
+  if (!alloc)
+    alloc = &lct_libc_allocator;
+
+  hdr = (lct_mem_hdr_t *) ptr - 1;
+  alloc->free(alloc->ctx, hdr, hdr->size);
+}
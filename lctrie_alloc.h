@@ -0,0 +1,48 @@
+#ifndef __LC_TRIE_ALLOC_H__
+#define __LC_TRIE_ALLOC_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pluggable memory allocation for the trie's interior arrays.
+//
+// Random lookups over a multi-megabyte node array are bound by TLB misses
+// long before they're bound by anything else, so it pays to be able to
+// control where the node, bases, and hot subnet arrays live.  The callbacks
+// are handed the user context along with the sizes of the allocations so
+// they can be backed by pre-reserved memory pools as easily as by mmap().
+typedef struct lct_allocator {
+  void *(*malloc)(void *ctx, size_t size);
+  void *(*realloc)(void *ctx, void *ptr, size_t oldsize, size_t size);
+  void (*free)(void *ctx, void *ptr, size_t size);
+  void *ctx;                // user context passed to every callback
+} lct_allocator_t;
+
+// plain old libc malloc(), realloc(), and free()
+extern const lct_allocator_t lct_libc_allocator;
+
+// places allocations on 2MB huge pages with mmap(MAP_HUGETLB), falling back
+// to transparent huge pages through madvise(MADV_HUGEPAGE) when the system
+// has no huge pages reserved.  allocations too small to fill half of a huge
+// page just get regular pages.
+extern const lct_allocator_t lct_hugepage_allocator;
+
+// allocation entry points used by the library.  these remember the size of
+// each allocation so the callbacks always get the sizes they were given.
+// a NULL allocator means lct_libc_allocator.  callers may use these to put
+// their subnet arrays in the same memory as the trie.
+extern void *lct_mem_alloc(const lct_allocator_t *alloc, size_t size);
+extern void *lct_mem_realloc(const lct_allocator_t *alloc, void *ptr, size_t size);
+extern void lct_mem_free(const lct_allocator_t *alloc, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
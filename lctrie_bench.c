@@ -0,0 +1,239 @@
+#include "lctrie_bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lctrie_bgp.h"
+
+// rows reported so far, for the CSV header and the JSON separators
+static int nreported = 0;
+static int saved_stdout = -1;
+
+static
+void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-d <BGP prefixes file> | -b <bogon file>] [-r <reps>] [-w <warmup>] [-n <keys>] [-m <bytes>] [-f <bits>] [-l <layout>] [-i] [-j]\n", name);
+  fprintf(stderr, "  -d  prefix table to benchmark against, default %s\n", BENCH_DATASET);
+  fprintf(stderr, "  -b  bare CIDR bogon list to benchmark against instead\n");
+  fprintf(stderr, "  -r  timed trials, default 10\n");
+  fprintf(stderr, "  -w  untimed warmup trials, default 1\n");
+  fprintf(stderr, "  -n  lookups per trial, default 10000000\n");
+  fprintf(stderr, "  -m  memory budget in bytes for the trie nodes and bases\n");
+  fprintf(stderr, "  -f  build a fast miss filter over blocks of this prefix length\n");
+  fprintf(stderr, "  -l  node layout, dfs (the default), bfs, or veb\n");
+  fprintf(stderr, "  -i  build the ASN inverted index along with the trie\n");
+  fprintf(stderr, "  -j  report JSON instead of CSV\n");
+  exit(EXIT_FAILURE);
+}
+
+void bench_parse(bench_opts_t *opts, int argc, char *argv[]) {
+  int opt;
+
+  memset(opts, 0, sizeof(bench_opts_t));
+  opts->dataset = BENCH_DATASET;
+  opts->reps = 10;
+  opts->warmup = 1;
+  opts->nkeys = 10000000;
+
+  while ((opt = getopt(argc, argv, "d:b:r:w:n:m:f:l:ij")) != -1) {
+    switch (opt) {
+      case 'd':
+        opts->dataset = optarg;
+        opts->bogon = 0;
+        break;
+      case 'b':
+        opts->dataset = optarg;
+        opts->bogon = 1;
+        break;
+      case 'r':
+        opts->reps = atoi(optarg);
+        break;
+      case 'w':
+        opts->warmup = atoi(optarg);
+        break;
+      case 'n':
+        opts->nkeys = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        opts->budget = strtoull(optarg, NULL, 10);
+        break;
+      case 'f':
+        opts->filter_bits = atoi(optarg);
+        break;
+      case 'l':
+        if (!strcmp(optarg, "dfs"))
+          opts->layout = LCT_LAYOUT_DFS;
+        else if (!strcmp(optarg, "bfs"))
+          opts->layout = LCT_LAYOUT_BFS;
+        else if (!strcmp(optarg, "veb"))
+          opts->layout = LCT_LAYOUT_VEB;
+        else
+          usage(basename(argv[0]));
+        break;
+      case 'i':
+        opts->asn_index = 1;
+        break;
+      case 'j':
+        opts->json = 1;
+        break;
+      default:
+        usage(basename(argv[0]));
+    }
+  }
+
+  if (optind < argc || opts->reps < 1 || opts->reps > BENCH_MAX_REPS ||
+      opts->warmup < 0 || opts->nkeys == 0)
+    usage(basename(argv[0]));
+}
+
+int bench_load(const bench_opts_t *opts, lct_subnet_t **subnets) {
+  lct_subnet_t *p;
+  int num = 0, rc;
+
+  if (!(p = (lct_subnet_t *) calloc(sizeof(lct_subnet_t), BENCH_MAX_ENTRIES))) {
+    fprintf(stderr, "Could not allocate subnet input buffer\n");
+    return -1;
+  }
+
+  num += init_private_subnets(&p[num], BENCH_MAX_ENTRIES);
+  num += init_special_subnets(&p[num], BENCH_MAX_ENTRIES - num);
+  if (opts->bogon)
+    rc = read_bogon_table((char *) opts->dataset, &p[num], BENCH_MAX_ENTRIES - num);
+  else
+    rc = read_prefix_table((char *) opts->dataset, &p[num], BENCH_MAX_ENTRIES - num);
+  if (rc < 0) {
+    fprintf(stderr, "could not read prefix file \"%s\"\n", opts->dataset);
+    free(p);
+    return -1;
+  }
+  num += rc;
+
+  *subnets = realloc(p, num * sizeof(lct_subnet_t));
+  return num;
+}
+
+uint32_t bench_prepare(lct_subnet_t *subnets, uint32_t num) {
+  lct_ip_stats_t *stats;
+
+  bench_quiet(1);
+  subnet_mask(subnets, num);
+  qsort(subnets, num, sizeof(lct_subnet_t), subnet_cmp);
+  num -= subnet_dedup(subnets, num);
+
+  if ((stats = (lct_ip_stats_t *) calloc(num, sizeof(lct_ip_stats_t)))) {
+    subnet_prefix(subnets, stats, num);
+    free(stats);
+  }
+  else {
+    fprintf(stderr, "Failed to allocate prefix statistics buffer\n");
+    num = 0;
+  }
+  bench_quiet(0);
+
+  return num;
+}
+
+int bench_build(const bench_opts_t *opts, lct_t *trie, lct_subnet_t *subnets,
+                uint32_t num) {
+  lct_opts_t lopts = { .budget = opts->budget, .filter_bits = opts->filter_bits,
+                       .layout = opts->layout, .asn_index = opts->asn_index };
+
+  memset(trie, 0, sizeof(lct_t));
+  return lct_build_opts(trie, subnets, num, &lopts);
+}
+
+uint32_t *bench_keys(uint32_t n, uint64_t seed) {
+  uint32_t *keys;
+
+  if (!(keys = (uint32_t *) malloc(n * sizeof(uint32_t)))) {
+    fprintf(stderr, "Could not allocate lookup keys\n");
+    return NULL;
+  }
+
+  // xorshift, never seeded with zero
+  seed = seed ? seed : 88172645463325252ULL;
+  for (uint32_t i = 0; i < n; ++i) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    keys[i] = (uint32_t) seed;
+  }
+
+  return keys;
+}
+
+double bench_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void bench_quiet(int quiet) {
+  int null;
+
+  fflush(stdout);
+  if (quiet && saved_stdout < 0) {
+    if ((null = open("/dev/null", O_WRONLY)) < 0)
+      return;
+    saved_stdout = dup(STDOUT_FILENO);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+  }
+  else if (!quiet && saved_stdout >= 0) {
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    saved_stdout = -1;
+  }
+}
+
+static
+int double_cmp(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+void bench_report(const bench_opts_t *opts, const char *bench,
+                  const char *metric, const char *unit,
+                  double *samples, int n) {
+  double median, mean = 0, var = 0;
+
+  if (!n)
+    return;
+
+  qsort(samples, n, sizeof(double), double_cmp);
+  median = (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+  for (int i = 0; i < n; ++i)
+    mean += samples[i];
+  mean /= n;
+  for (int i = 0; i < n; ++i)
+    var += (samples[i] - mean) * (samples[i] - mean);
+  var = (n > 1) ? var / (n - 1) : 0;
+
+  if (opts->json) {
+    printf("%s  {\"bench\": \"%s\", \"metric\": \"%s\", \"unit\": \"%s\", "
+           "\"dataset\": \"%s\", \"warmup\": %d, \"reps\": %d, "
+           "\"median\": %.10g, \"mean\": %.10g, \"stddev\": %.10g, "
+           "\"min\": %.10g, \"max\": %.10g}",
+           nreported ? ",\n" : "[\n", bench, metric, unit, opts->dataset,
+           opts->warmup, n, median, mean, sqrt(var), samples[0], samples[n - 1]);
+  }
+  else {
+    if (!nreported)
+      printf("bench,metric,unit,dataset,warmup,reps,median,mean,stddev,min,max\n");
+    printf("%s,%s,%s,%s,%d,%d,%.10g,%.10g,%.10g,%.10g,%.10g\n", bench, metric, unit,
+           opts->dataset, opts->warmup, n, median, mean, sqrt(var),
+           samples[0], samples[n - 1]);
+  }
+  ++nreported;
+  fflush(stdout);
+}
+
+void bench_finish(const bench_opts_t *opts) {
+  if (opts->json)
+    printf("%s]\n", nreported ? "\n" : "[\n");
+}
@@ -0,0 +1,80 @@
+#ifndef __LC_TRIE_BENCH_H__
+#define __LC_TRIE_BENCH_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lctrie_ip.h"
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared plumbing for the bench_* programs
+//
+// Every benchmark runs a number of untimed warmup trials followed by the
+// timed ones, and reports each metric as one CSV row or JSON object with
+// the median, mean, standard deviation, minimum and maximum of the trials.
+// The results go to stdout, and anything the library prints along the way
+// is kept out of it so the output can be fed straight to a regression
+// tracker.
+
+#define BENCH_DATASET       "bgp/data-raw-table"
+#define BENCH_MAX_ENTRIES   4000000
+#define BENCH_MAX_REPS      1000
+
+typedef struct bench_opts {
+  const char *dataset;    // prefix table to load
+  int bogon;              // dataset is a bare CIDR bogon list
+  int reps;               // timed trials
+  int warmup;             // untimed trials first
+  int json;               // JSON instead of CSV
+  uint32_t nkeys;         // lookups per trial
+  size_t budget;          // node and base byte budget for the build, 0 for
+                          // the default level compression
+  uint8_t filter_bits;    // block length of the fast miss filter, 0 for none
+  uint8_t layout;         // LCT_LAYOUT_* order of the node array
+  int asn_index;          // build the ASN inverted index along with the trie
+} bench_opts_t;
+
+// parse the common command line options, exits with usage on errors
+extern void bench_parse(bench_opts_t *opts, int argc, char *argv[]);
+
+// read the dataset with the private and special ranges in front of it,
+// without any preprocessing.  returns the number of subnets, or negative
+// on failure.  the buffer is malloc'd and owned by the caller.
+extern int bench_load(const bench_opts_t *opts, lct_subnet_t **subnets);
+
+// mask, sort, dedup, and link up loaded subnets ready for a build, the
+// same as lctrie_test does.  returns the number of subnets left.
+extern uint32_t bench_prepare(lct_subnet_t *subnets, uint32_t num);
+
+// build the trie the way the options ask for
+extern int bench_build(const bench_opts_t *opts, lct_t *trie, lct_subnet_t *subnets,
+                       uint32_t num);
+
+// pseudo-random lookup keys, the same ones for a given seed every run
+extern uint32_t *bench_keys(uint32_t n, uint64_t seed);
+
+// monotonic clock in seconds
+extern double bench_now(void);
+
+// point stdout at /dev/null while the library chatters, and back again
+extern void bench_quiet(int quiet);
+
+// report the samples of one metric
+extern void bench_report(const bench_opts_t *opts, const char *bench,
+                         const char *metric, const char *unit,
+                         double *samples, int n);
+
+// close off the report, must be called once at the end
+extern void bench_finish(const bench_opts_t *opts);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
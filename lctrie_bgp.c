@@ -125,5 +125,183 @@ int
 read_asn_table(char *filename,
                lct_bgp_asn_t prefix[],
                size_t prefix_size) {
-  return -1;
+  int num = 0;
+  FILE *infile;
+  char *line = NULL;
+  size_t line_len = 0;
+
+  // a right aligned ASN, then the owner's description to the end of line
+  pcre *re;
+  const char *pattern = "^[ \\t]*(\\d+)[ \\t]+(.*)$";
+  #define ASN_OVECCOUNT 3 * 3 // we'll have 3 substring matches
+  const char *error;
+  int erroffset;
+  int rc;
+  int ovector[ASN_OVECCOUNT];
+
+  char input[16];
+  char *substr_start;
+  int substr_len;
+  unsigned long asn;
+
+  if (!(infile = fopen(filename, "r"))) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return -1;
+  }
+
+  re = pcre_compile(pattern, 0, &error, &erroffset, NULL);
+  if (!re) {
+    fprintf(stderr, "PCRE compilation failed at offset: %d: %s\n",
+            erroffset, error);
+    fclose(infile);
+    return -1;
+  }
+
+  while (num < prefix_size && -1 != getline(&line, &line_len, infile)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] == 0)
+      continue;
+
+    rc = pcre_exec(re,
+                   0,
+                   line,
+                   strlen(line),
+                   0,
+                   0,
+                   ovector,
+                   ASN_OVECCOUNT);
+    if (rc < 0) {
+      switch (rc) {
+        case PCRE_ERROR_NOMATCH:
+          fprintf(stderr, "invalid line: %s\n", line);
+          break;
+
+        default:
+          fprintf(stderr, "Matching error %d on line: %s\n", rc, line);
+          break;
+      }
+      continue;
+    }
+
+    // validate and extract the ASN, index 1 in the PCRE matches
+    substr_start = line + ovector[2*1];
+    substr_len = ovector[2*1 + 1] - ovector[2*1];
+    snprintf(input, sizeof(input), "%.*s", substr_len, substr_start);
+    errno = 0;
+    asn = strtoul(input, NULL, 10);
+    if (errno || asn > UINT32_MAX) {
+      fprintf(stderr, "ERROR: %s is not a valid ASN\n", input);
+      continue;
+    }
+
+    // and the description, index 2 in the PCRE matches
+    substr_start = line + ovector[2*2];
+    substr_len = ovector[2*2 + 1] - ovector[2*2];
+    if (!(prefix[num].desc = strndup(substr_start, substr_len))) {
+      fprintf(stderr, "ERROR: failed to allocate ASN description\n");
+      break;
+    }
+    prefix[num].num = asn;
+
+    num++;
+  }
+
+  free(line);
+  pcre_free(re);
+  fclose(infile);
+
+  return num;
+}
+
+int
+read_bogon_table(char *filename,
+                 lct_subnet_t prefix[],
+                 size_t prefix_size) {
+  int num = 0;
+  FILE *infile;
+  char *line = NULL;
+  size_t line_len = 0;
+
+  // one bare CIDR per line, with # comment lines
+  pcre *re;
+  const char *pattern = "^((\\d{1,3}\\.){3}\\d{1,3})\\/(\\d{1,2})$";
+  #define BOGON_PREFIX_OVECCOUNT 3 * 4 // we'll have 4 substring matches
+  const char *error;
+  int erroffset;
+  int rc;
+  int ovector[BOGON_PREFIX_OVECCOUNT];
+
+  char input[INET_ADDRSTRLEN];
+  char *substr_start;
+  int substr_len;
+
+  if (!(infile = fopen(filename, "r"))) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return -1;
+  }
+
+  re = pcre_compile(pattern, 0, &error, &erroffset, NULL);
+  if (!re) {
+    fprintf(stderr, "PCRE compilation failed at offset: %d: %s\n",
+            erroffset, error);
+    fclose(infile);
+    return -1;
+  }
+
+  while (num < prefix_size && -1 != getline(&line, &line_len, infile)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] == '#' || line[0] == 0)
+      continue;
+
+    rc = pcre_exec(re,
+                   0,
+                   line,
+                   strlen(line),
+                   0,
+                   0,
+                   ovector,
+                   BOGON_PREFIX_OVECCOUNT);
+    if (rc < 0) {
+      switch (rc) {
+        case PCRE_ERROR_NOMATCH:
+          fprintf(stderr, "invalid line: %s\n", line);
+          break;
+
+        default:
+          fprintf(stderr, "Matching error %d on line: %s\n", rc, line);
+          break;
+      }
+      continue;
+    }
+
+    // validate and extract IP prefix, index 1 in the PCRE matches
+    substr_start = line + ovector[2*1];
+    substr_len = ovector[2*1 + 1] - ovector[2*1];
+    snprintf(input, sizeof(input), "%.*s", substr_len, substr_start);
+    if (!inet_pton(AF_INET, input, &(prefix[num].addr))) {
+      fprintf(stderr, "ERROR: %s is not a valid IP address: %s\n", input, strerror(errno));
+      continue;
+    }
+    prefix[num].addr = ntohl(prefix[num].addr);
+
+    // validate and extract prefix length, index 3 in the PCRE matches
+    substr_start = line + ovector[2*3];
+    substr_len = ovector[2*3 + 1] - ovector[2*3];
+    snprintf(input, sizeof(input), "%.*s", substr_len, substr_start);
+    prefix[num].len = strtoul(input, NULL, 10);
+    if ((prefix[num].len == 0) || (prefix[num].len > 32)) {
+      fprintf(stderr, "ERROR: %d is not a valid prefix length\n", prefix[num].len);
+      continue;
+    }
+
+    prefix[num].info.type = IP_SUBNET_BOGON;
+
+    num++;
+  }
+
+  free(line);
+  pcre_free(re);
+  fclose(infile);
+
+  return num;
 }
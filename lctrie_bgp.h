@@ -7,6 +7,10 @@
 
 #include "lctrie_ip.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct lct_bgp_asn {
   uint32_t num;
   char *desc;
@@ -20,7 +24,16 @@ read_prefix_table(char *filename,
                   lct_subnet_t prefix[],
                   size_t prefix_size);
 
+// read a bogon list of bare CIDR prefixes, one per line
+// return number of entries read
+// return negative on failure
+extern int
+read_bogon_table(char *filename,
+                 lct_subnet_t prefix[],
+                 size_t prefix_size);
+
 // read the ASN to description file
+// the descriptions are strdup()'d and owned by the caller
 // return number of entries read
 // return negative on failure
 extern int
@@ -28,5 +41,9 @@ read_asn_table(char *filename,
                lct_bgp_asn_t prefix[],
                size_t prefix_size);
 
+#ifdef __cplusplus
+}
+#endif
+
 // end #ifndef guard
 #endif
@@ -0,0 +1,101 @@
+#include "lctrie_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BLOCK_MASK    (~(UINT32_MAX >> LCT_CACHE_BLOCK))
+
+int lct_cache_init(lct_cache_t *cache, uint32_t nsets) {
+  if (!cache || !nsets)
+    return -1;
+
+  // keep at least two sets so the set hash never shifts by all 32 bits
+  memset(cache, 0, sizeof(lct_cache_t));
+  cache->bits = 1;
+  while ((1U << cache->bits) < nsets && cache->bits < 31)
+    ++cache->bits;
+
+  cache->sets = (lct_cache_set_t *) calloc(1U << cache->bits, sizeof(lct_cache_set_t));
+  if (!cache->sets) {
+    fprintf(stderr, "ERROR: failed to allocate flow cache\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+void lct_cache_free(lct_cache_t *cache) {
+  if (!cache)
+    return;
+
+  free(cache->sets);
+  cache->sets = NULL;
+}
+
+// set an address or a block lands in
+static inline
+lct_cache_set_t *cache_set(const lct_cache_t *cache, uint32_t k) {
+  return &cache->sets[(k * 2654435761U) >> (32 - cache->bits)];
+}
+
+// way of a set holding an entry for an address or a block, or -1
+static inline
+int cache_probe(const lct_cache_set_t *set, uint32_t k, uint8_t block) {
+  for (int w = 0; w < LCT_CACHE_WAYS; ++w)
+    if ((set->valid & (1 << w)) && !(set->block & (1 << w)) == !block && set->key[w] == k)
+      return w;
+  return -1;
+}
+
+lct_subnet_t *lct_cache_find(lct_cache_t *cache, lct_t *trie, uint32_t key) {
+  lct_cache_set_t *aset, *bset, *set;
+  uint32_t blk, idx;
+  int uniform, w;
+
+  if (!cache || !trie)
+    return NULL;
+
+  // the trie was rebuilt, so everything we have is stale
+  if (cache->gen != trie->gen) {
+    memset(cache->sets, 0, (1U << cache->bits) * sizeof(lct_cache_set_t));
+    cache->gen = trie->gen;
+  }
+
+  // addresses are spread over the sets by the whole address, so the busy
+  // hosts of one /24 don't all fight over a single set, and blocks by the
+  // block.  the address's own set is probed first, then its block's.
+  blk = key & BLOCK_MASK;
+  aset = cache_set(cache, key);
+  bset = cache_set(cache, blk >> (32 - LCT_CACHE_BLOCK));
+  if ((w = cache_probe(aset, key, 0)) >= 0)
+    set = aset;
+  else if ((w = cache_probe(bset, blk, 1)) >= 0)
+    set = bset;
+  else
+    set = NULL;
+
+  if (set) {
+    ++cache->hits;
+    idx = set->idx[w];
+    return (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+  }
+
+  ++cache->misses;
+  idx = lct_find_idx_block(trie, key, LCT_CACHE_BLOCK, &uniform);
+
+  set = uniform ? bset : aset;
+  w = set->next;
+  set->next = (w + 1) % LCT_CACHE_WAYS;
+  set->valid |= 1 << w;
+  set->idx[w] = idx;
+  if (uniform) {
+    set->key[w] = blk;
+    set->block |= 1 << w;
+  }
+  else {
+    set->key[w] = key;
+    set->block &= ~(1 << w);
+  }
+
+  return (idx != IP_PREFIX_NIL) ? &trie->nets[idx] : NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef __LC_TRIE_CACHE_H__
+#define __LC_TRIE_CACHE_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per thread flow cache in front of the trie
+//
+// Real traffic is heavily skewed towards a few thousand addresses, so a
+// small set associative cache of lookup results catches most lookups before
+// they ever touch the trie.  An entry is keyed on the address itself, or on
+// the whole /24 around it when every address in that block is known to
+// resolve to the same subnet.  Address entries are spread over the sets by
+// the whole address and block entries by the block, so a lookup probes at
+// most two sets.  The cache remembers the generation of the trie its
+// entries came from and flushes itself when handed a rebuilt trie.
+//
+// A cache is not thread safe, every lookup thread needs its own.
+
+#define LCT_CACHE_WAYS      4
+#define LCT_CACHE_BLOCK     24  // prefix length of block entries
+
+typedef struct lct_cache_set {
+  uint32_t key[LCT_CACHE_WAYS];   // address or block of each way
+  uint32_t idx[LCT_CACHE_WAYS];   // subnet index, IP_PREFIX_NIL for misses
+  uint8_t valid;                  // bitmask of ways holding entries
+  uint8_t block;                  // bitmask of ways holding block entries
+  uint8_t next;                   // next way to replace
+} lct_cache_set_t;
+
+typedef struct lct_cache {
+  uint32_t gen;             // generation of the trie the entries came from
+  uint32_t bits;            // log2 of the number of sets
+  lct_cache_set_t *sets;
+  uint64_t hits;            // lookups answered by the cache
+  uint64_t misses;          // lookups that had to go to the trie
+} lct_cache_t;
+
+// set up an empty cache with at least nsets sets of LCT_CACHE_WAYS entries
+extern int lct_cache_init(lct_cache_t *cache, uint32_t nsets);
+extern void lct_cache_free(lct_cache_t *cache);
+
+// trie search function going through the cache first
+// return the IP subnet corresponding to the element,
+// otherwise return NULL if not found
+// key must be provided in host byte ordering
+extern lct_subnet_t *lct_cache_find(lct_cache_t *cache, lct_t *trie, uint32_t key);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
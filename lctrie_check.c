@@ -0,0 +1,925 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <libgen.h>
+#include <string.h>
+#include <errno.h>
+#include <locale.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include <arpa/inet.h>
+#include <sys/time.h>
+
+#include "lctrie_ip.h"
+#include "lctrie_bgp.h"
+#include "lctrie.h"
+#include "lctrie_numa.h"
+#include "lctrie_multi.h"
+#include "lctrie_cache.h"
+#include "lctrie_pipe.h"
+
+// Differential lookup checker
+//
+// Every lookup engine is run over the same keys and compared against a
+// reference longest prefix match that is simple enough to trust by reading
+// it.  The reference is a sweep over the sorted subnets that cuts the
+// address space into intervals with a single answer each, and the sweep
+// itself is spot checked against a plain linear scan over every subnet.
+// The keys are the edges of every interval plus random addresses, or with
+// -x every last one of the 2^32 addresses for the smaller tables.
+
+#define CHECK_MAX_ENTRIES         4000000
+#define CHECK_RANDOM_KEYS         4000000
+#define CHECK_LINEAR_KEYS         2000
+#define CHECK_EXHAUSTIVE_MAX      100000    // largest table to sweep fully
+#define CHECK_CHUNK               (1 << 20)
+
+// state shared by the engines for one table
+typedef struct check_ctx {
+  lct_t *trie;
+  lct_t small;                  // same table with a narrow root and sparse fill
+  lct_t filtered;               // same table with a fast miss filter
+  lct_t bfs;                    // narrow trie relaid out breadth first
+  lct_t veb;                    // narrow trie built in the vEB layout
+  lct_t hot;                    // trie shaped around a traffic profile
+  lct_subnet_t **results;       // scratch for the pointer returning engines
+  lct_cache_t cache;
+  lct_numa_t numa;
+  lct_pipe_t pipe;
+  lct_multi_t multi;            // the table added twice, sharing everything
+  lct_subnet_t *aggnets[2];     // the table aggregated on each projection
+  lct_t agg[2];
+} check_ctx_t;
+
+// a lookup engine resolves n keys into subnet indexes, IP_PREFIX_NIL for
+// keys that don't match anything
+typedef struct check_engine {
+  const char *name;
+  int (*run)(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n);
+} check_engine_t;
+
+// an address range with a single longest prefix match
+typedef struct check_interval {
+  uint32_t start;
+  uint32_t idx;
+} check_interval_t;
+
+static uint64_t seed = 88172645463325252ULL;
+
+static
+uint32_t xorshift(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (uint32_t) seed;
+}
+
+static inline
+uint32_t subnet_idx(const lct_t *trie, const lct_subnet_t *subnet) {
+  return subnet ? subnet - trie->nets : IP_PREFIX_NIL;
+}
+
+static
+int run_find(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = subnet_idx(ctx->trie, lct_find(ctx->trie, keys[i]));
+  return 0;
+}
+
+static
+int run_find_idx(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = lct_find_idx(ctx->trie, keys[i]);
+  return 0;
+}
+
+static
+int run_batch(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  if (lct_find_batch(ctx->trie, keys, ctx->results, n))
+    return -1;
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = subnet_idx(ctx->trie, ctx->results[i]);
+  return 0;
+}
+
+static
+int run_cache(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = subnet_idx(ctx->trie, lct_cache_find(&ctx->cache, ctx->trie, keys[i]));
+  return 0;
+}
+
+static
+int run_numa(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  lct_t *replica = lct_numa_replica(&ctx->numa, 1);
+
+  if (!replica)
+    return -1;
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = lct_find_idx(replica, keys[i]);
+  return 0;
+}
+
+// the attribute id has to be the id of the info of the subnet matched,
+// anything else comes back as a bogus index
+static
+int run_find_id(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  lct_t *t = ctx->trie;
+  uint32_t id;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    idx[i] = lct_find_idx(t, keys[i]);
+    id = lct_find_id(t, keys[i]);
+    if ((idx[i] == IP_PREFIX_NIL) ? (id != LCT_ATTR_NIL) :
+        (id >= t->acount || !subnet_info_eq(&t->attrs[id], &t->nets[idx[i]].info) ||
+         id != (t->attr16 ? t->attr16[idx[i]] : t->attr32[idx[i]])))
+      idx[i] = t->scount;
+  }
+  return 0;
+}
+
+// the aggregated tables only have to agree on the projection of the
+// match, so check that and hand back the index of the real match
+static
+int run_aggregate(check_ctx_t *ctx, int proj, const uint32_t *keys, uint32_t *idx,
+                  uint32_t n) {
+  const lct_subnet_info_t *a, *b;
+  lct_subnet_t *s;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    idx[i] = lct_find_idx(ctx->trie, keys[i]);
+    s = lct_find(&ctx->agg[proj], keys[i]);
+    if (idx[i] == IP_PREFIX_NIL || !s) {
+      if (s || idx[i] != IP_PREFIX_NIL)
+        idx[i] = ctx->trie->scount;
+      continue;
+    }
+
+    a = &ctx->trie->nets[idx[i]].info;
+    b = &s->info;
+    if (a->type != b->type ||
+        (proj == IP_PROJ_ASN && a->type == IP_SUBNET_BGP && a->bgp.asn != b->bgp.asn))
+      idx[i] = ctx->trie->scount;
+  }
+  return 0;
+}
+
+static
+int run_agg_type(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  return run_aggregate(ctx, IP_PROJ_TYPE, keys, idx, n);
+}
+
+static
+int run_agg_asn(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  return run_aggregate(ctx, IP_PROJ_ASN, keys, idx, n);
+}
+
+static
+int run_small(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = lct_find_idx(&ctx->small, keys[i]);
+  return 0;
+}
+
+static
+int run_bfs(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = lct_find_idx(&ctx->bfs, keys[i]);
+  return 0;
+}
+
+static
+int run_veb(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  if (lct_find_batch(&ctx->veb, keys, ctx->results, n))
+    return -1;
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = subnet_idx(&ctx->veb, ctx->results[i]);
+  return 0;
+}
+
+static
+int run_hot(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = lct_find_idx(&ctx->hot, keys[i]);
+  return 0;
+}
+
+static
+int run_filter(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = lct_find_idx(&ctx->filtered, keys[i]);
+  return 0;
+}
+
+static
+int run_filter_batch(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  if (lct_find_batch(&ctx->filtered, keys, ctx->results, n))
+    return -1;
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = subnet_idx(&ctx->filtered, ctx->results[i]);
+  return 0;
+}
+
+static
+int run_find_all(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  lct_subnet_t *all[32];
+
+  for (uint32_t i = 0; i < n; ++i)
+    idx[i] = (lct_find_all(ctx->trie, keys[i], all, 32) > 0) ?
+             subnet_idx(ctx->trie, all[0]) : IP_PREFIX_NIL;
+  return 0;
+}
+
+// scan the keys like a log processor would, reusing the last answer while
+// the keys stay inside of its range.  a range reaching past the answer, or
+// stopping short of where it changes, comes back as a bogus index.
+static
+int run_find_range(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  lct_t *t = ctx->trie;
+  uint32_t lo = 1, hi = 0, ans = IP_PREFIX_NIL;
+  lct_subnet_t *s;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    if (keys[i] >= lo && keys[i] <= hi) {
+      idx[i] = ans;
+      continue;
+    }
+
+    s = lct_find_range(t, keys[i], &lo, &hi);
+    ans = subnet_idx(t, s);
+    idx[i] = ans;
+    if (keys[i] < lo || keys[i] > hi ||
+        lct_find_idx(t, lo) != ans || lct_find_idx(t, hi) != ans ||
+        (lo > 0 && lct_find_idx(t, lo - 1) == ans) ||
+        (hi < UINT32_MAX && lct_find_idx(t, hi + 1) == ans)) {
+      idx[i] = t->scount;
+      lo = 1;
+      hi = 0;
+    }
+  }
+  return 0;
+}
+
+// the arena has its own copies of the subnets, so look the answers up by
+// address and length in the table
+static
+int run_multi(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  const lct_t *t = ctx->trie;
+  lct_subnet_t *s;
+  uint32_t lo, hi, mid;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    idx[i] = IP_PREFIX_NIL;
+    if (!(s = lct_multi_find(&ctx->multi, 1, keys[i])))
+      continue;
+    for (lo = 0, hi = t->scount; lo < hi;) {
+      mid = lo + (hi - lo) / 2;
+      if (t->nets[mid].addr < s->addr ||
+          (t->nets[mid].addr == s->addr && t->nets[mid].len < s->len))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo < t->scount && t->nets[lo].addr == s->addr && t->nets[lo].len == s->len)
+      idx[i] = lo;
+  }
+  return 0;
+}
+
+// round robin batches over the workers, keeping a couple in flight on each
+static
+int run_pipe(check_ctx_t *ctx, const uint32_t *keys, uint32_t *idx, uint32_t n) {
+  lct_pipe_batch_t batches[8], *batch, *freelist[8];
+  uint32_t nfree = 0, next = 0, done = 0, w = 0, off, idle = 0;
+
+  for (int i = 0; i < 8; ++i)
+    freelist[nfree++] = &batches[i];
+
+  while (done < n) {
+    if (next < n && nfree) {
+      batch = freelist[--nfree];
+      batch->n = (n - next < LCT_PIPE_BATCH) ? n - next : LCT_PIPE_BATCH;
+      batch->user = (void *) (uintptr_t) next;
+      memcpy(batch->keys, &keys[next], batch->n * sizeof(uint32_t));
+      if (lct_pipe_submit(&ctx->pipe, w, batch))
+        freelist[nfree++] = batch;
+      else
+        next += batch->n;
+    }
+
+    if ((batch = lct_pipe_collect(&ctx->pipe, w))) {
+      off = (uint32_t) (uintptr_t) batch->user;
+      for (uint32_t i = 0; i < batch->n; ++i)
+        idx[off + i] = subnet_idx(ctx->trie, batch->results[i]);
+      done += batch->n;
+      freelist[nfree++] = batch;
+      idle = 0;
+    }
+    else if (++idle >= 64) {
+      sched_yield();
+      idle = 0;
+    }
+
+    w = (w + 1) % ctx->pipe.nworkers;
+  }
+
+  return 0;
+}
+
+static check_engine_t engines[] = {
+  { "lct_find", run_find },
+  { "lct_find_idx", run_find_idx },
+  { "lct_find_batch", run_batch },
+  { "lct_cache_find", run_cache },
+  { "numa replica", run_numa },
+  { "narrow trie", run_small },
+  { "bfs relayout", run_bfs },
+  { "veb layout batch", run_veb },
+  { "profiled trie", run_hot },
+  { "fast miss filter", run_filter },
+  { "filtered batch", run_filter_batch },
+  { "lct_find_id", run_find_id },
+  { "aggregate type", run_agg_type },
+  { "aggregate asn", run_agg_asn },
+  { "lct_find_all", run_find_all },
+  { "lct_find_range", run_find_range },
+  { "lct_pipe", run_pipe },
+  { "lct_multi_find", run_multi },
+};
+
+#define CHECK_NENGINES  (sizeof(engines) / sizeof(engines[0]))
+
+// the obviously correct reference, try every subnet
+static
+uint32_t linear_lpm(const lct_subnet_t *nets, uint32_t num, uint32_t key) {
+  uint32_t best = IP_PREFIX_NIL, mask;
+
+  for (uint32_t i = 0; i < num; ++i) {
+    mask = (uint32_t) ~(0xffffffffULL >> nets[i].len);
+    if ((key & mask) == nets[i].addr &&
+        (best == IP_PREFIX_NIL || nets[i].len > nets[best].len))
+      best = i;
+  }
+
+  return best;
+}
+
+// sweep the sorted subnets keeping a stack of the ones enclosing the
+// current address.  an interval ends wherever a subnet starts or ends.
+static
+uint32_t sweep(const lct_subnet_t *nets, uint32_t num, check_interval_t *out) {
+  uint32_t stack[33], depth = 0, count = 0, top;
+  uint64_t cur = 0, last;
+
+  #define SWEEP_EMIT(end, answer) \
+    if (cur <= (end)) { \
+      out[count].start = cur; \
+      out[count++].idx = (answer); \
+      cur = (uint64_t) (end) + 1; \
+    }
+
+  for (uint32_t i = 0; i <= num; ++i) {
+    // close off every subnet ending before the next one starts
+    while (depth) {
+      top = stack[depth - 1];
+      last = (uint64_t) nets[top].addr + (1ULL << (32 - nets[top].len)) - 1;
+      if (i < num && last >= nets[i].addr)
+        break;
+      SWEEP_EMIT(last, top);
+      --depth;
+    }
+    if (i == num)
+      break;
+
+    if (nets[i].addr > 0)
+      SWEEP_EMIT((uint64_t) nets[i].addr - 1, depth ? stack[depth - 1] : IP_PREFIX_NIL);
+    stack[depth++] = i;
+  }
+  SWEEP_EMIT(UINT32_MAX, IP_PREFIX_NIL);
+
+  #undef SWEEP_EMIT
+  return count;
+}
+
+static
+uint32_t interval_lpm(const check_interval_t *iv, uint32_t count, uint32_t key) {
+  uint32_t lo = 0, hi = count;
+
+  // last interval starting at or before the key
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (iv[mid].start <= key)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return iv[lo].idx;
+}
+
+static
+void print_key(const char *label, uint32_t key) {
+  char pstr[INET_ADDRSTRLEN];
+  uint32_t addr = htonl(key);
+
+  inet_ntop(AF_INET, &addr, pstr, sizeof(pstr));
+  printf("%s%s", label, pstr);
+}
+
+static
+void print_answer(const lct_t *trie, const char *label, uint32_t idx) {
+  if (idx == IP_PREFIX_NIL) {
+    printf("%snothing", label);
+    return;
+  }
+  if (idx >= trie->scount) {
+    printf("%sa bad answer (#%u)", label, idx);
+    return;
+  }
+  print_key(label, trie->nets[idx].addr);
+  printf("/%u (#%u)", trie->nets[idx].len, idx);
+}
+
+// mask, sort, dedup, and link up the prefixes ready for a build
+static
+uint32_t prepare(lct_subnet_t *p, uint32_t num) {
+  lct_ip_stats_t *stats;
+
+  subnet_mask(p, num);
+  qsort(p, num, sizeof(lct_subnet_t), subnet_cmp);
+  num -= subnet_dedup(p, num);
+
+  if (!(stats = (lct_ip_stats_t *) calloc(num, sizeof(lct_ip_stats_t)))) {
+    fprintf(stderr, "Failed to allocate prefix statistics buffer\n");
+    return 0;
+  }
+  subnet_prefix(p, stats, num);
+  free(stats);
+
+  return num;
+}
+
+// random table of nested prefixes.  most prefixes are carved out of an
+// earlier one so the table has deep prefix chains like real routing tables.
+static
+uint32_t random_table(lct_subnet_t *p, uint32_t num) {
+  uint32_t len;
+
+  memset(p, 0, num * sizeof(lct_subnet_t));
+  for (uint32_t i = 0; i < num; ++i) {
+    // a few kinds of subnets so the aggregates have something to keep apart
+    if (xorshift() % 2) {
+      p[i].info.type = IP_SUBNET_BGP;
+      p[i].info.bgp.asn = xorshift() % 4;
+    }
+    else {
+      p[i].info.type = IP_SUBNET_USER;
+    }
+    if (i > 0 && xorshift() % 3) {
+      const lct_subnet_t *parent = &p[xorshift() % i];
+      len = parent->len + 1 + xorshift() % 8;
+      p[i].len = (len > 32) ? 32 : len;
+      p[i].addr = parent->addr | (xorshift() & (uint32_t) (0xffffffffULL >> parent->len));
+    }
+    else {
+      p[i].len = 8 + xorshift() % 17;
+      p[i].addr = xorshift();
+    }
+    p[i].addr &= (uint32_t) ~(0xffffffffULL >> p[i].len);
+  }
+
+  return prepare(p, num);
+}
+
+// the first, second, and last address of every interval, followed by
+// random keys with every fourth one repeating an earlier random key.
+// returns the number of keys and where the random ones start.
+static
+uint32_t make_keys(const check_interval_t *iv, uint32_t niv, uint64_t kseed,
+                   uint32_t *keys, uint32_t *expect, uint32_t *rstart) {
+  uint32_t nkeys = 0, end;
+
+  for (uint32_t i = 0; i < niv; ++i) {
+    end = (i + 1 < niv) ? iv[i + 1].start - 1 : UINT32_MAX;
+    keys[nkeys++] = iv[i].start;
+    keys[nkeys++] = (iv[i].start < end) ? iv[i].start + 1 : end;
+    keys[nkeys++] = end;
+  }
+
+  *rstart = nkeys;
+  seed = kseed;
+  for (uint32_t i = 0; i < CHECK_RANDOM_KEYS; ++i, ++nkeys)
+    keys[nkeys] = (i % 4 == 3) ? keys[*rstart + xorshift() % (nkeys - *rstart)] : xorshift();
+
+  for (uint32_t i = 0; i < nkeys; ++i)
+    expect[i] = interval_lpm(iv, niv, keys[i]);
+
+  return nkeys;
+}
+
+// compare one engine against the reference over a set of keys.  prints the
+// first mismatching key and returns the number of mismatches, or -1 if the
+// engine failed to run at all.
+static
+long check_keys(check_ctx_t *ctx, const check_engine_t *e, const uint32_t *keys,
+                const uint32_t *expect, uint32_t *got, uint32_t n, int *reported) {
+  long bad = 0;
+
+  if (e->run(ctx, keys, got, n))
+    return -1;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    if (got[i] == expect[i])
+      continue;
+    if (!*reported) {
+      print_key("  first mismatch at ", keys[i]);
+      print_answer(ctx->trie, ", expected ", expect[i]);
+      print_answer(ctx->trie, ", got ", got[i]);
+      printf("\n");
+      *reported = 1;
+    }
+    ++bad;
+  }
+
+  return bad;
+}
+
+// walk the whole address space a chunk at a time, following along in the
+// interval list instead of searching it
+static
+long check_all(check_ctx_t *ctx, const check_engine_t *e, const check_interval_t *iv,
+               uint32_t niv, uint32_t *keys, uint32_t *expect, uint32_t *got,
+               int *reported) {
+  uint32_t cur = 0;
+  long bad = 0;
+
+  for (uint64_t base = 0; base < (1ULL << 32) && bad == 0; base += CHECK_CHUNK) {
+    for (uint32_t i = 0; i < CHECK_CHUNK; ++i) {
+      keys[i] = base + i;
+      while (cur + 1 < niv && iv[cur + 1].start <= keys[i])
+        ++cur;
+      expect[i] = iv[cur].idx;
+    }
+    bad = check_keys(ctx, e, keys, expect, got, CHECK_CHUNK, reported);
+  }
+
+  return bad;
+}
+
+// batch keys the filter answers ahead of any key walking the trie, first
+// the filter answering the lowest key, then a repeated 0.0.0.0, and then
+// keys in blocks the filter can't answer.  returns 1 if any disagree.
+static
+int check_filter_batch(check_ctx_t *ctx, const check_interval_t *iv, uint32_t niv) {
+  const lct_t *f = &ctx->filtered;
+  uint32_t keys[256], n = 0, bad = 0, blk, nblk = 1U << f->filter_bits;
+
+  // the first block the filter answers
+  for (blk = 0; blk < nblk && !(f->filter[blk >> 6].uniform & (1ULL << (blk & 63))); ++blk);
+  if (blk < nblk)
+    keys[n++] = blk << (32 - f->filter_bits);
+  keys[n++] = 0;
+  keys[n++] = 0;
+
+  // and keys past it in blocks the filter can't answer
+  for (++blk; blk < nblk && n < 256; ++blk)
+    if (!(f->filter[blk >> 6].uniform & (1ULL << (blk & 63))))
+      keys[n++] = (blk << (32 - f->filter_bits)) | (xorshift() & ((1U << (32 - f->filter_bits)) - 1));
+
+  if (lct_find_batch(&ctx->filtered, keys, ctx->results, n))
+    bad = n;
+  for (uint32_t i = 0; !bad && i < n; ++i) {
+    if (subnet_idx(&ctx->filtered, ctx->results[i]) != interval_lpm(iv, niv, keys[i])) {
+      print_key("  filter answered batch disagrees at ", keys[i]);
+      printf("\n");
+      ++bad;
+    }
+  }
+
+  printf("  %-16s %s, %u keys\n", "filter first", bad ? "FAILED" : "ok", n);
+  return bad != 0;
+}
+
+// merge the address ranges of sorted, possibly nested or touching blocks
+// into disjoint ranges, returning how many there are
+static
+uint32_t union_ranges(const lct_cidr_t *c, uint32_t n, uint64_t *lo, uint64_t *hi) {
+  uint32_t nr = 0;
+  uint64_t start, end;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    start = c[i].addr;
+    end = start + (1ULL << (32 - c[i].len));
+    if (nr && start <= hi[nr - 1]) {
+      if (end > hi[nr - 1])
+        hi[nr - 1] = end;
+      continue;
+    }
+    lo[nr] = start;
+    hi[nr++] = end;
+  }
+
+  return nr;
+}
+
+// every BGP subnet has to be listed exactly once, in order, under its own
+// ASN, and each ASN's blocks have to be sorted, disjoint, unmergeable, and
+// cover exactly the addresses of its subnets.  returns 1 if it failed.
+static
+int check_asn_index(const lct_t *t) {
+  const uint32_t *idx;
+  const lct_cidr_t *cidrs;
+  lct_cidr_t *nets;
+  uint64_t *lo[2], *hi[2];
+  uint32_t n, nc, nr[2], total = 0, nbgp = 0, bad = 0, size;
+
+  for (uint32_t i = 0; i < t->scount; ++i)
+    nbgp += (t->nets[i].info.type == IP_SUBNET_BGP);
+
+  nets = (lct_cidr_t *) malloc((nbgp + 1) * sizeof(lct_cidr_t));
+  for (int k = 0; k < 2; ++k) {
+    lo[k] = (uint64_t *) malloc((nbgp + 1) * sizeof(uint64_t));
+    hi[k] = (uint64_t *) malloc((nbgp + 1) * sizeof(uint64_t));
+  }
+  if (!nets || !lo[0] || !hi[0] || !lo[1] || !hi[1]) {
+    fprintf(stderr, "Failed to set up the ASN index check\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (uint32_t a = 0; a < t->nasns && !bad; ++a) {
+    if (a > 0 && t->asns[a - 1] >= t->asns[a])
+      ++bad;
+
+    n = lct_asn_subnets(t, t->asns[a], &idx);
+    nc = lct_asn_cidrs(t, t->asns[a], &cidrs);
+    total += n;
+    for (uint32_t i = 0; i < n; ++i) {
+      if (idx[i] >= t->scount || t->nets[idx[i]].info.type != IP_SUBNET_BGP ||
+          t->nets[idx[i]].info.bgp.asn != t->asns[a] || (i > 0 && idx[i - 1] >= idx[i]))
+        ++bad;
+      nets[i].addr = t->nets[idx[i]].addr;
+      nets[i].len = t->nets[idx[i]].len;
+    }
+
+    for (uint32_t i = 1; i < nc; ++i) {
+      size = cidrs[i].len ? (uint32_t) (0x100000000ULL >> cidrs[i].len) : 0;
+      if ((uint64_t) cidrs[i - 1].addr + (1ULL << (32 - cidrs[i - 1].len)) > cidrs[i].addr ||
+          (size && cidrs[i - 1].len == cidrs[i].len && !(cidrs[i - 1].addr & size) &&
+           cidrs[i - 1].addr + size == cidrs[i].addr))
+        ++bad;
+    }
+
+    nr[0] = union_ranges(nets, n, lo[0], hi[0]);
+    nr[1] = union_ranges(cidrs, nc, lo[1], hi[1]);
+    if (nr[0] != nr[1] || memcmp(lo[0], lo[1], nr[0] * sizeof(uint64_t)) ||
+        memcmp(hi[0], hi[1], nr[0] * sizeof(uint64_t)))
+      ++bad;
+  }
+
+  if (total != nbgp)
+    ++bad;
+
+  printf("  %-16s %s, %'u ASNs with %'u subnets in %'u blocks\n", "asn index",
+         bad ? "FAILED" : "ok", t->nasns, total, t->nasns ? t->cidr_off[t->nasns] : 0);
+
+  free(nets);
+  for (int k = 0; k < 2; ++k) {
+    free(lo[k]);
+    free(hi[k]);
+  }
+  return bad != 0;
+}
+
+// copy the table and aggregate it down on a projection
+static
+int build_aggregate(check_ctx_t *ctx, const lct_subnet_t *p, uint32_t num, int proj) {
+  int anum;
+
+  if (!(ctx->aggnets[proj] = (lct_subnet_t *) malloc(num * sizeof(lct_subnet_t))))
+    return -1;
+  memcpy(ctx->aggnets[proj], p, num * sizeof(lct_subnet_t));
+  if ((anum = subnet_aggregate(ctx->aggnets[proj], num, proj)) <= 0)
+    return -1;
+  return lct_build(&ctx->agg[proj], ctx->aggnets[proj], anum);
+}
+
+// check every engine against one table.  returns the number of engines
+// that disagreed with the reference.
+static
+int check_table(const char *desc, lct_subnet_t *p, uint32_t num, int exhaustive) {
+  check_ctx_t ctx;
+  check_interval_t *iv;
+  lct_t t;
+  uint32_t niv, nkeys, rstart, *keys, *expect, *got, linear = 0;
+  uint32_t topo_cpus[2] = { 0, 1 };
+  lct_numa_topo_t topo = { .nnodes = 2, .ncpus = 2, .cpu_node = topo_cpus };
+  lct_opts_t attr_opts = { .attrs = 1, .asn_index = 1 };
+  lct_opts_t small_opts = { .root_branch = 8, .fill = 25 };
+  lct_opts_t filter_opts = { .filter_bits = 20 };
+  lct_opts_t veb_opts = { .root_branch = 8, .fill = 25, .layout = LCT_LAYOUT_VEB };
+  uint32_t prof_keys[4096];
+  lct_profile_t prof = { prof_keys, NULL, 4096 };
+  lct_opts_t hot_opts = { .root_branch = 8, .layout = LCT_LAYOUT_HOT, .profile = &prof };
+  uint64_t kseed = xorshift();
+  int failed = 0;
+
+  printf("Checking %s, %'u subnets\n", desc, num);
+
+  // traffic piled up on a few of the subnets
+  for (uint32_t i = 0; i < prof.n; ++i)
+    prof_keys[i] = p[xorshift() % 64 % num].addr + xorshift() % 256;
+
+  memset(&t, 0, sizeof(lct_t));
+  if (lct_build_opts(&t, p, num, &attr_opts)) {
+    printf("  FAILED to build the trie\n\n");
+    return 1;
+  }
+
+  // only sweep the whole address space for the smaller tables
+  exhaustive = exhaustive && num <= CHECK_EXHAUSTIVE_MAX;
+
+  memset(&ctx, 0, sizeof(check_ctx_t));
+  ctx.trie = &t;
+  iv = (check_interval_t *) malloc((2 * num + 1) * sizeof(check_interval_t));
+  nkeys = 3 * (2 * num + 1) + CHECK_RANDOM_KEYS;
+  if (nkeys < CHECK_CHUNK)
+    nkeys = CHECK_CHUNK;
+  keys = (uint32_t *) malloc(nkeys * sizeof(uint32_t));
+  expect = (uint32_t *) malloc(nkeys * sizeof(uint32_t));
+  got = (uint32_t *) malloc(nkeys * sizeof(uint32_t));
+  ctx.results = (lct_subnet_t **) malloc(nkeys * sizeof(lct_subnet_t *));
+  if (!iv || !keys || !expect || !got || !ctx.results ||
+      lct_cache_init(&ctx.cache, 4096) || lct_numa_init(&ctx.numa, &topo) ||
+      lct_numa_publish(&ctx.numa, &t) || lct_pipe_start(&ctx.pipe, &t, 2, 4) ||
+      lct_build_opts(&ctx.small, p, num, &small_opts) ||
+      lct_build_opts(&ctx.bfs, p, num, &small_opts) || lct_relayout(&ctx.bfs, LCT_LAYOUT_BFS) ||
+      lct_build_opts(&ctx.veb, p, num, &veb_opts) || lct_build_opts(&ctx.hot, p, num, &hot_opts) ||
+      lct_build_opts(&ctx.filtered, p, num, &filter_opts) || lct_multi_init(&ctx.multi) ||
+      lct_multi_add(&ctx.multi, p, num, NULL) < 0 || lct_multi_add(&ctx.multi, p, num, NULL) < 0 ||
+      build_aggregate(&ctx, p, num, IP_PROJ_TYPE) || build_aggregate(&ctx, p, num, IP_PROJ_ASN)) {
+    fprintf(stderr, "Failed to set up the checks\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("  aggregates down to %'u subnets by type and %'u by ASN\n",
+         ctx.agg[IP_PROJ_TYPE].scount, ctx.agg[IP_PROJ_ASN].scount);
+
+  niv = sweep(p, num, iv);
+
+  // make sure the sweep agrees with the brute force scan
+  for (uint32_t i = 0; i < CHECK_LINEAR_KEYS; ++i) {
+    uint32_t key = (i % 2) ? xorshift() : p[xorshift() % num].addr;
+    if (linear_lpm(p, num, key) != interval_lpm(iv, niv, key)) {
+      if (!linear) {
+        print_key("  reference sweep disagrees with the linear scan at ", key);
+        printf("\n");
+      }
+      ++linear;
+    }
+  }
+
+  for (int e = 0; !linear && e < CHECK_NENGINES; ++e) {
+    int reported = 0;
+    long bad, edge;
+
+    // the exhaustive sweep clobbers the key set, so every engine gets a
+    // fresh copy of the same keys
+    nkeys = make_keys(iv, niv, kseed, keys, expect, &rstart);
+
+    // time the random keys, then check the interval edges untimed
+    struct timeval start, now;
+    gettimeofday(&start, NULL);
+    bad = check_keys(&ctx, &engines[e], &keys[rstart], &expect[rstart], &got[rstart],
+                     nkeys - rstart, &reported);
+    gettimeofday(&now, NULL);
+    unsigned long took_us = 1000000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec);
+
+    if (bad >= 0) {
+      edge = check_keys(&ctx, &engines[e], keys, expect, got, rstart, &reported);
+      bad = (edge < 0) ? edge : bad + edge;
+    }
+    if (bad == 0 && exhaustive)
+      bad = check_all(&ctx, &engines[e], iv, niv, keys, expect, got, &reported);
+
+    if (bad < 0) {
+      printf("  %-16s FAILED to run\n", engines[e].name);
+      ++failed;
+      continue;
+    }
+
+    printf("  %-16s %s, %'ld mismatches, %'lu lookups/sec%s\n", engines[e].name,
+           bad ? "FAILED" : "ok", bad,
+           took_us ? (unsigned long) ((nkeys - rstart) * 1000000ULL / took_us) : 0UL,
+           (exhaustive && !bad) ? ", all 2^32 addresses" : "");
+    if (bad)
+      ++failed;
+  }
+
+  if (!linear)
+    failed += check_filter_batch(&ctx, iv, niv);
+  failed += check_asn_index(&t);
+  failed += check_asn_index(lct_numa_replica(&ctx.numa, 1));
+
+  if (linear) {
+    printf("  FAILED %u reference mismatches against the linear scan\n", linear);
+    ++failed;
+  }
+  printf("\n");
+
+  lct_pipe_stop(&ctx.pipe);
+  lct_numa_free(&ctx.numa);
+  lct_cache_free(&ctx.cache);
+  lct_free(&ctx.small);
+  lct_free(&ctx.filtered);
+  lct_free(&ctx.bfs);
+  lct_free(&ctx.veb);
+  lct_free(&ctx.hot);
+  lct_multi_free(&ctx.multi);
+  for (int i = 0; i < 2; ++i) {
+    lct_free(&ctx.agg[i]);
+    free(ctx.aggnets[i]);
+  }
+  lct_free(&t);
+  free(ctx.results);
+  free(got);
+  free(expect);
+  free(keys);
+  free(iv);
+
+  return failed;
+}
+
+static
+void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-x] [-r <random tables>] [-b <bogon file>] [BGP prefixes file]\n", name);
+  fprintf(stderr, "  -x  also check all 2^32 addresses on tables of up to %u subnets\n",
+          CHECK_EXHAUSTIVE_MAX);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+  lct_subnet_t *p;
+  char *bogons = "bgp/fullbogons-ipv4.txt", desc[64];
+  int opt, exhaustive = 0, nrandom = 4, failed = 0, rc;
+  uint32_t num, sizes[] = { 16, 1000, 30000, 300000 };
+
+  while ((opt = getopt(argc, argv, "xr:b:")) != -1) {
+    switch (opt) {
+      case 'x':
+        exhaustive = 1;
+        break;
+      case 'r':
+        nrandom = atoi(optarg);
+        break;
+      case 'b':
+        bogons = optarg;
+        break;
+      default:
+        usage(basename(argv[0]));
+    }
+  }
+  if (optind + 1 < argc)
+    usage(basename(argv[0]));
+
+  // we need this to get thousands separators
+  setlocale(LC_NUMERIC, "");
+
+  if (!(p = (lct_subnet_t *) calloc(sizeof(lct_subnet_t), CHECK_MAX_ENTRIES))) {
+    fprintf(stderr, "Could not allocate subnet input buffer\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // the BGP table on top of the private and special ranges, like lctrie_test
+  if (optind < argc) {
+    num = init_private_subnets(p, CHECK_MAX_ENTRIES);
+    num += init_special_subnets(&p[num], CHECK_MAX_ENTRIES - num);
+    if (0 > (rc = read_prefix_table(argv[optind], &p[num], CHECK_MAX_ENTRIES - num))) {
+      fprintf(stderr, "could not read prefix file \"%s\"\n", argv[optind]);
+      exit(EXIT_FAILURE);
+    }
+    num = prepare(p, num + rc);
+    failed += check_table(argv[optind], p, num, exhaustive);
+  }
+
+  memset(p, 0, CHECK_MAX_ENTRIES * sizeof(lct_subnet_t));
+  if (0 < (rc = read_bogon_table(bogons, p, CHECK_MAX_ENTRIES))) {
+    num = prepare(p, rc);
+    failed += check_table(bogons, p, num, exhaustive);
+  }
+
+  for (int i = 0; i < nrandom; ++i) {
+    snprintf(desc, sizeof(desc), "random table %d", i);
+    num = random_table(p, sizes[i % 4]);
+    failed += check_table(desc, p, num, exhaustive);
+  }
+
+  free(p);
+
+  if (failed) {
+    printf("%d checks FAILED\n", failed);
+    return EXIT_FAILURE;
+  }
+  printf("All checks passed.\n");
+
+  return 0;
+}
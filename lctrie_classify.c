@@ -0,0 +1,848 @@
+// memrchr()
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <libgen.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lctrie_ip.h"
+#include "lctrie_bgp.h"
+#include "lctrie.h"
+#include "lctrie_acct.h"
+#include "lctrie_bench.h"
+
+// Bulk address classifier
+//
+// Loads the prefix, bogon, and ASN tables once, then streams addresses
+// through the trie the way an enrichment job over a day of flow or web
+// logs would.  Regular files are mmapped and everything else is read, one
+// address per line as text, or packed big endian uint32s with -r.  The
+// input is cut into chunks at line boundaries, worker threads parse and
+// classify whole chunks with batched lookups, and the chunks are written
+// back out in input order, so the output lines up with the input.  A
+// window of chunks in flight keeps the memory bounded no matter how far
+// ahead the workers get of a slow consumer.
+//
+// Text lines only need to start with the address, so the first field of a
+// CSV or space separated log is good enough.  Lines that don't start with
+// one are counted as invalid and skipped.
+//
+// Output is one of:
+//   csv     addr,prefix,len,type,asn per address, the default
+//   bin     a 16 byte record per address, see below
+//   prefix  per prefix hit counts, prefix,len,type,asn,count
+//   asn     per ASN hit counts, with the non-BGP types rolled up by type
+//
+// Throughput is reported on stderr at the end, which makes the tool an end
+// to end benchmark of the library on real inputs as well.
+
+#define CLASSIFY_DATASET          "bgp/data-raw-table"
+#define CLASSIFY_MAX_ENTRIES      4000000
+#define CLASSIFY_MAX_ASNS         1000000
+#define CLASSIFY_CHUNK            (4 << 20)   // input bytes per work unit
+#define CLASSIFY_WINDOW           4           // chunks in flight per thread
+#define CLASSIFY_CSV_LINE         64          // longest csv line we write
+
+#define OUT_CSV         0
+#define OUT_BIN         1
+#define OUT_PREFIX      2
+#define OUT_ASN         3
+
+// the bin output record, every field big endian.  type is the
+// IP_SUBNET_* of the match, with IP_SUBNET_UNUSED for misses, and asn is
+// 0 for anything other than BGP prefixes.
+typedef struct classify_rec {
+  uint32_t addr;
+  uint32_t prefix;
+  uint32_t asn;
+  uint8_t len;
+  uint8_t type;
+  uint16_t pad;
+} classify_rec_t;
+
+// one chunk of input and its output
+typedef struct classify_chunk {
+  const char *data;       // into the mapping, or buf for read input
+  size_t len;
+  char *buf;              // copy of read input
+  char *out;              // formatted output of the chunk
+  size_t outlen, outcap;
+  int done;               // classified and ready to write
+} classify_chunk_t;
+
+typedef struct classify {
+  lct_t trie;
+  lct_bgp_asn_t *asns;    // ASN descriptions sorted by ASN
+  int nasns;
+  int raw;                // input is packed big endian uint32s
+  int mode;               // OUT_*
+  uint32_t nthreads;
+  lct_acct_t acct;        // hit counts for the aggregate modes
+
+  // the current input, either mapped or read from fd
+  const char *map;
+  size_t maplen, mappos;
+  int fd;
+  char *carry;            // partial line or key left over from the last read
+  size_t ncarry;
+  int fdeof;
+
+  // chunks in flight, seq is the next to hand out and written the next
+  // to write out, each lives in slots[n % nslots]
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  classify_chunk_t *slots;
+  uint32_t nslots;
+  uint64_t seq, written;
+  int eof;
+  int failed;
+
+  // totals
+  uint64_t naddrs;
+  uint64_t ninvalid;
+  uint64_t nbytes;
+} classify_t;
+
+typedef struct classify_worker {
+  classify_t *c;
+  uint32_t id;
+  pthread_t thread;
+  uint32_t *keys;
+  lct_subnet_t **results;
+  size_t cap;
+  uint64_t naddrs;
+  uint64_t ninvalid;
+} classify_worker_t;
+
+static const char *type_names[] = {
+  "none", "bgp", "private", "linklocal", "multicast",
+  "broadcast", "loopback", "reserved", "bogon", "user",
+};
+
+static inline
+const char *type_name(uint32_t type) {
+  return (type < sizeof(type_names) / sizeof(type_names[0])) ? type_names[type] : "none";
+}
+
+static inline
+char *put_uint(char *o, uint32_t v) {
+  char tmp[10];
+  int n = 0;
+
+  do {
+    tmp[n++] = '0' + v % 10;
+  } while (v /= 10);
+  while (n)
+    *o++ = tmp[--n];
+  return o;
+}
+
+static inline
+char *put_ip(char *o, uint32_t addr) {
+  o = put_uint(o, addr >> 24);
+  *o++ = '.';
+  o = put_uint(o, (addr >> 16) & 0xff);
+  *o++ = '.';
+  o = put_uint(o, (addr >> 8) & 0xff);
+  *o++ = '.';
+  return put_uint(o, addr & 0xff);
+}
+
+static inline
+char *put_be32(char *o, uint32_t v) {
+  *o++ = v >> 24;
+  *o++ = v >> 16;
+  *o++ = v >> 8;
+  *o++ = v;
+  return o;
+}
+
+// parse a dotted quad at the start of [p, end), which has to be followed
+// by the end of the line or a field separator
+static inline
+int parse_addr(const char *p, const char *end, uint32_t *addr) {
+  uint32_t a = 0, octet;
+  int digits;
+
+  for (int i = 0; i < 4; ++i) {
+    octet = 0;
+    digits = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits <= 3) {
+      octet = octet * 10 + (*p++ - '0');
+      ++digits;
+    }
+    if (!digits || digits > 3 || octet > 255)
+      return 0;
+    a = (a << 8) | octet;
+    if (i < 3) {
+      if (p >= end || *p != '.')
+        return 0;
+      ++p;
+    }
+  }
+
+  if (p < end && *p != ',' && *p != ' ' && *p != '\t' && *p != '\r')
+    return 0;
+
+  *addr = a;
+  return 1;
+}
+
+// parse a chunk of input into keys, returns the number of keys
+static
+uint32_t parse_chunk(classify_worker_t *w, const char *p, size_t len) {
+  const char *end = p + len, *eol;
+  uint32_t n = 0;
+
+  if (w->c->raw) {
+    for (; p + 4 <= end; p += 4) {
+      w->keys[n++] = ((uint32_t) (uint8_t) p[0] << 24) | ((uint32_t) (uint8_t) p[1] << 16) |
+                     ((uint32_t) (uint8_t) p[2] << 8) | (uint32_t) (uint8_t) p[3];
+    }
+    return n;
+  }
+
+  while (p < end) {
+    if (!(eol = memchr(p, '\n', end - p)))
+      eol = end;
+    if (parse_addr(p, eol, &w->keys[n]))
+      ++n;
+    else if (eol > p && !(eol == p + 1 && *p == '\r'))
+      ++w->ninvalid;
+    p = eol + 1;
+  }
+  return n;
+}
+
+// make room for the keys of a chunk of len bytes, the shortest text line
+// holding an address is 8 bytes with its newline
+static
+int worker_reserve(classify_worker_t *w, size_t len) {
+  size_t need = w->c->raw ? len / 4 : len / 7 + 1;
+
+  if (need <= w->cap)
+    return 0;
+
+  free(w->keys);
+  free(w->results);
+  w->keys = (uint32_t *) malloc(need * sizeof(uint32_t));
+  w->results = (lct_subnet_t **) malloc(need * sizeof(lct_subnet_t *));
+  if (!w->keys || !w->results) {
+    fprintf(stderr, "ERROR: failed to allocate classifier key buffers\n");
+    w->cap = 0;
+    return -1;
+  }
+  w->cap = need;
+  return 0;
+}
+
+static
+int chunk_reserve(classify_chunk_t *ch, size_t need) {
+  char *out;
+
+  if (need <= ch->outcap)
+    return 0;
+
+  if (!(out = (char *) realloc(ch->out, need))) {
+    fprintf(stderr, "ERROR: failed to allocate classifier output buffer\n");
+    return -1;
+  }
+  ch->out = out;
+  ch->outcap = need;
+  return 0;
+}
+
+// cut the next chunk off the current input, returns 0 at the end of it,
+// or negative on a read error.  called with the lock held.
+static
+int read_chunk(classify_t *c, classify_chunk_t *ch) {
+  const char *nl;
+  size_t len;
+  ssize_t rc;
+
+  if (c->map) {
+    if (c->mappos >= c->maplen)
+      return 0;
+
+    len = c->maplen - c->mappos;
+    if (len > CLASSIFY_CHUNK) {
+      len = CLASSIFY_CHUNK;
+      if (c->raw)
+        len -= len % 4;
+      else if ((nl = memchr(c->map + c->mappos + len, '\n', c->maplen - c->mappos - len)))
+        len = nl - (c->map + c->mappos) + 1;
+      else
+        len = c->maplen - c->mappos;
+    }
+
+    ch->data = c->map + c->mappos;
+    c->mappos += len;
+
+    // same as below, a trailing partial key at the end of the map is dropped
+    if (c->raw && len % 4) {
+      fprintf(stderr, "WARNING: ignoring %zu trailing bytes\n", len % 4);
+      len -= len % 4;
+      if (!len)
+        return 0;
+    }
+
+    ch->len = len;
+    return 1;
+  }
+
+  if (c->fdeof && !c->ncarry)
+    return 0;
+
+  if (!ch->buf && !(ch->buf = (char *) malloc(CLASSIFY_CHUNK))) {
+    fprintf(stderr, "ERROR: failed to allocate classifier input buffer\n");
+    return -1;
+  }
+
+  // whatever was left over from the last read goes in front
+  memcpy(ch->buf, c->carry, c->ncarry);
+  len = c->ncarry;
+  c->ncarry = 0;
+
+  while (!c->fdeof && len < CLASSIFY_CHUNK) {
+    if ((rc = read(c->fd, ch->buf + len, CLASSIFY_CHUNK - len)) < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "ERROR: %s\n", strerror(errno));
+      return -1;
+    }
+    if (!rc)
+      c->fdeof = 1;
+    len += rc;
+  }
+
+  // hold back a partial line or key for the next read, unless it's all
+  // there is.  a trailing partial key at the end of the input is dropped.
+  if (c->raw) {
+    c->ncarry = len % 4;
+    if (c->fdeof && c->ncarry) {
+      fprintf(stderr, "WARNING: ignoring %zu trailing bytes\n", c->ncarry);
+      c->ncarry = 0;
+    }
+  }
+  else if (!c->fdeof && (nl = memrchr(ch->buf, '\n', len))) {
+    c->ncarry = len - (nl - ch->buf + 1);
+  }
+  len -= c->ncarry;
+  memcpy(c->carry, ch->buf + len, c->ncarry);
+
+  if (!len)
+    return 0;
+
+  ch->data = ch->buf;
+  ch->len = len;
+  return 1;
+}
+
+// hand out the next chunk to classify, NULL once the input is done
+static
+classify_chunk_t *next_chunk(classify_t *c) {
+  classify_chunk_t *ch = NULL;
+  int rc;
+
+  pthread_mutex_lock(&c->lock);
+  while (!c->eof && c->seq >= c->written + c->nslots)
+    pthread_cond_wait(&c->cond, &c->lock);
+
+  if (!c->eof) {
+    ch = &c->slots[c->seq % c->nslots];
+    if ((rc = read_chunk(c, ch)) > 0) {
+      ch->done = 0;
+      ch->outlen = 0;
+      c->nbytes += ch->len;
+      ++c->seq;
+    }
+    else {
+      if (rc < 0)
+        c->failed = 1;
+      c->eof = 1;
+      ch = NULL;
+      pthread_cond_broadcast(&c->cond);
+    }
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  return ch;
+}
+
+// format or count the results of a chunk
+static
+int emit_chunk(classify_worker_t *w, classify_chunk_t *ch, uint32_t n) {
+  classify_t *c = w->c;
+  lct_counter_t *counts;
+  lct_subnet_t *s;
+  char *o;
+
+  switch (c->mode) {
+    case OUT_CSV:
+      if (chunk_reserve(ch, (size_t) n * CLASSIFY_CSV_LINE))
+        return -1;
+      o = ch->out;
+      for (uint32_t i = 0; i < n; ++i) {
+        s = w->results[i];
+        o = put_ip(o, w->keys[i]);
+        *o++ = ',';
+        if (s) {
+          o = put_ip(o, s->addr);
+          *o++ = ',';
+          o = put_uint(o, s->len);
+        }
+        else {
+          *o++ = ',';
+        }
+        *o++ = ',';
+        o = stpcpy(o, type_name(s ? s->info.type : IP_SUBNET_UNUSED));
+        *o++ = ',';
+        if (s && s->info.type == IP_SUBNET_BGP)
+          o = put_uint(o, s->info.bgp.asn);
+        *o++ = '\n';
+      }
+      ch->outlen = o - ch->out;
+      break;
+
+    case OUT_BIN:
+      if (chunk_reserve(ch, (size_t) n * sizeof(classify_rec_t)))
+        return -1;
+      o = ch->out;
+      for (uint32_t i = 0; i < n; ++i) {
+        s = w->results[i];
+        o = put_be32(o, w->keys[i]);
+        o = put_be32(o, s ? s->addr : 0);
+        o = put_be32(o, (s && s->info.type == IP_SUBNET_BGP) ? s->info.bgp.asn : 0);
+        *o++ = s ? s->len : 0;
+        *o++ = s ? s->info.type : IP_SUBNET_UNUSED;
+        *o++ = 0;
+        *o++ = 0;
+      }
+      ch->outlen = o - ch->out;
+      break;
+
+    default:
+      // only this thread writes its slot, and nothing reads them until
+      // all of the workers have been joined
+      counts = c->acct.slots[w->id];
+      for (uint32_t i = 0; i < n; ++i)
+        ++counts[w->results[i] ? w->results[i] - c->trie.nets : c->acct.nslots - 1].pkts;
+      break;
+  }
+
+  return 0;
+}
+
+static
+void *classify_worker(void *arg) {
+  classify_worker_t *w = (classify_worker_t *) arg;
+  classify_t *c = w->c;
+  classify_chunk_t *ch;
+  uint32_t n = 0;
+  int rc;
+
+  while ((ch = next_chunk(c))) {
+    rc = worker_reserve(w, ch->len);
+    if (!rc) {
+      n = parse_chunk(w, ch->data, ch->len);
+      w->naddrs += n;
+      rc = lct_find_batch(&c->trie, w->keys, w->results, n);
+    }
+    if (!rc)
+      rc = emit_chunk(w, ch, n);
+
+    pthread_mutex_lock(&c->lock);
+    if (rc) {
+      c->failed = 1;
+      c->eof = 1;
+    }
+    ch->done = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+  }
+
+  return NULL;
+}
+
+// classify one input, the mapping if there is one otherwise the fd
+static
+int classify_input(classify_t *c, classify_worker_t *workers) {
+  classify_chunk_t *ch;
+  uint32_t started = 0;
+  size_t len;
+
+  c->seq = c->written = 0;
+  c->eof = c->fdeof = 0;
+  c->ncarry = 0;
+
+  for (; started < c->nthreads; ++started) {
+    if (pthread_create(&workers[started].thread, NULL, classify_worker, &workers[started])) {
+      fprintf(stderr, "ERROR: failed to start classifier thread\n");
+      pthread_mutex_lock(&c->lock);
+      c->failed = c->eof = 1;
+      pthread_mutex_unlock(&c->lock);
+      break;
+    }
+  }
+
+  // write the chunks out in order as they finish
+  pthread_mutex_lock(&c->lock);
+  while (started) {
+    ch = &c->slots[c->written % c->nslots];
+    if (c->written < c->seq && ch->done) {
+      len = ch->outlen;
+      pthread_mutex_unlock(&c->lock);
+      if (len && fwrite(ch->out, 1, len, stdout) != len) {
+        fprintf(stderr, "ERROR: %s\n", strerror(errno));
+        pthread_mutex_lock(&c->lock);
+        c->failed = c->eof = 1;
+      }
+      else {
+        pthread_mutex_lock(&c->lock);
+      }
+      ++c->written;
+      pthread_cond_broadcast(&c->cond);
+    }
+    else if (c->eof && c->written == c->seq) {
+      break;
+    }
+    else {
+      pthread_cond_wait(&c->cond, &c->lock);
+    }
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  for (uint32_t i = 0; i < started; ++i)
+    pthread_join(workers[i].thread, NULL);
+
+  return c->failed ? -1 : 0;
+}
+
+static
+int classify_file(classify_t *c, classify_worker_t *workers, const char *filename) {
+  struct stat st;
+  void *map = NULL;
+  int rc;
+
+  if (!strcmp(filename, "-")) {
+    c->fd = STDIN_FILENO;
+  }
+  else if ((c->fd = open(filename, O_RDONLY)) < 0) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return -1;
+  }
+
+  // map regular files, and read anything else
+  if (!fstat(c->fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (map == MAP_FAILED) {
+      map = NULL;
+    }
+    else {
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      c->map = (const char *) map;
+      c->maplen = st.st_size;
+      c->mappos = 0;
+    }
+  }
+
+  rc = classify_input(c, workers);
+
+  if (map)
+    munmap(map, st.st_size);
+  c->map = NULL;
+  if (c->fd != STDIN_FILENO)
+    close(c->fd);
+
+  return rc;
+}
+
+static
+int asn_cmp(const void *di, const void *dj) {
+  const lct_bgp_asn_t *i = (const lct_bgp_asn_t *) di;
+  const lct_bgp_asn_t *j = (const lct_bgp_asn_t *) dj;
+
+  return (i->num > j->num) - (i->num < j->num);
+}
+
+static
+const char *asn_desc(const classify_t *c, uint32_t asn) {
+  lct_bgp_asn_t key = { .num = asn }, *found;
+
+  if (!c->nasns)
+    return "";
+  found = bsearch(&key, c->asns, c->nasns, sizeof(lct_bgp_asn_t), asn_cmp);
+  return found ? found->desc : "";
+}
+
+// print a csv field, quoted since ASN descriptions are full of commas
+static
+void print_quoted(const char *str) {
+  putchar('"');
+  for (; *str; ++str) {
+    if (*str == '"')
+      putchar('"');
+    putchar(*str);
+  }
+  putchar('"');
+}
+
+static
+int report_counts(classify_t *c) {
+  lct_counter_t *merged, bytype[LCT_ACCT_NTYPES];
+  lct_asn_counter_t *asns;
+  lct_subnet_t *s;
+  char pstr[16];
+  int nasn;
+
+  if (!(merged = (lct_counter_t *) calloc(c->acct.nslots, sizeof(lct_counter_t)))) {
+    fprintf(stderr, "ERROR: failed to allocate merged counters\n");
+    return -1;
+  }
+  lct_acct_merge(&c->acct, merged);
+
+  if (c->mode == OUT_PREFIX) {
+    printf("prefix,len,type,asn,count\n");
+    for (uint32_t i = 0; i < c->trie.scount; ++i) {
+      if (!merged[i].pkts)
+        continue;
+      s = &c->trie.nets[i];
+      *put_ip(pstr, s->addr) = 0;
+      printf("%s,%u,%s,", pstr, s->len, type_name(s->info.type));
+      if (s->info.type == IP_SUBNET_BGP)
+        printf("%u", s->info.bgp.asn);
+      printf(",%lu\n", merged[i].pkts);
+    }
+    if (merged[c->acct.nslots - 1].pkts)
+      printf(",,none,,%lu\n", merged[c->acct.nslots - 1].pkts);
+  }
+  else {
+    if ((nasn = lct_acct_by_asn(&c->acct, merged, &asns)) < 0) {
+      fprintf(stderr, "ERROR: failed to roll up counters by ASN\n");
+      free(merged);
+      return -1;
+    }
+    lct_acct_by_type(&c->acct, merged, bytype);
+    bytype[IP_SUBNET_UNUSED].pkts += merged[c->acct.nslots - 1].pkts;
+
+    printf("type,asn,name,count\n");
+    for (int i = 0; i < LCT_ACCT_NTYPES; ++i) {
+      if (i != IP_SUBNET_BGP && bytype[i].pkts)
+        printf("%s,,,%lu\n", type_name(i), bytype[i].pkts);
+    }
+    for (int i = 0; i < nasn; ++i) {
+      printf("bgp,%u,", asns[i].asn);
+      print_quoted(asn_desc(c, asns[i].asn));
+      printf(",%lu\n", asns[i].count.pkts);
+    }
+    free(asns);
+  }
+
+  free(merged);
+  return 0;
+}
+
+// load and build the tables, keeping the library's chatter out of the
+// output on stdout
+static
+int classify_load(classify_t *c, const char *prefixfile, const char *bogonfile,
+                  const char *asnfile) {
+  lct_subnet_t *p;
+  uint32_t num = 0;
+  int rc;
+
+  if (!(p = (lct_subnet_t *) calloc(sizeof(lct_subnet_t), CLASSIFY_MAX_ENTRIES))) {
+    fprintf(stderr, "Could not allocate subnet input buffer\n");
+    return -1;
+  }
+
+  num += init_private_subnets(&p[num], CLASSIFY_MAX_ENTRIES);
+  num += init_special_subnets(&p[num], CLASSIFY_MAX_ENTRIES - num);
+
+  // bogons go in ahead of the BGP prefixes, so they win the dedup
+  if (bogonfile) {
+    if ((rc = read_bogon_table((char *) bogonfile, &p[num], CLASSIFY_MAX_ENTRIES - num)) < 0) {
+      fprintf(stderr, "could not read bogon file \"%s\"\n", bogonfile);
+      free(p);
+      return -1;
+    }
+    num += rc;
+  }
+
+  if (prefixfile) {
+    if ((rc = read_prefix_table((char *) prefixfile, &p[num], CLASSIFY_MAX_ENTRIES - num)) < 0) {
+      fprintf(stderr, "could not read prefix file \"%s\"\n", prefixfile);
+      free(p);
+      return -1;
+    }
+    num += rc;
+  }
+
+  if (asnfile) {
+    if (!(c->asns = (lct_bgp_asn_t *) calloc(sizeof(lct_bgp_asn_t), CLASSIFY_MAX_ASNS))) {
+      fprintf(stderr, "Could not allocate ASN buffer\n");
+      free(p);
+      return -1;
+    }
+    if ((c->nasns = read_asn_table((char *) asnfile, c->asns, CLASSIFY_MAX_ASNS)) < 0) {
+      fprintf(stderr, "could not read ASN file \"%s\"\n", asnfile);
+      free(c->asns);
+      c->asns = NULL;
+      free(p);
+      return -1;
+    }
+    qsort(c->asns, c->nasns, sizeof(lct_bgp_asn_t), asn_cmp);
+  }
+
+  num = bench_prepare(p, num);
+  bench_quiet(1);
+  rc = num ? lct_build(&c->trie, p, num) : -1;
+  bench_quiet(0);
+  if (rc < 0) {
+    fprintf(stderr, "could not build the trie\n");
+    free(p);
+    return -1;
+  }
+
+  return 0;
+}
+
+static
+void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-p <prefix file>] [-b <bogon file>] [-a <ASN file>] [-t <threads>] [-r] [-o csv|bin|prefix|asn] [input files]\n", name);
+  fprintf(stderr, "  -p  BGP prefix table, default %s\n", CLASSIFY_DATASET);
+  fprintf(stderr, "  -b  bare CIDR bogon list to classify against as well\n");
+  fprintf(stderr, "  -a  ASN description file for the asn counts\n");
+  fprintf(stderr, "  -t  classifier threads, default one per CPU\n");
+  fprintf(stderr, "  -r  input is packed big endian uint32s instead of text\n");
+  fprintf(stderr, "  -o  output per address as csv or bin, or counts per prefix or asn\n");
+  fprintf(stderr, "  input files default to stdin, - reads stdin as well\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+  const char *prefixfile = CLASSIFY_DATASET, *bogonfile = NULL, *asnfile = NULL;
+  classify_t c = { .mode = OUT_CSV };
+  classify_worker_t *workers;
+  struct timespec start, end;
+  double elapsed;
+  long ncpu;
+  int opt, rc = 0;
+
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  c.nthreads = (ncpu > 0) ? ncpu : 1;
+
+  while ((opt = getopt(argc, argv, "p:b:a:t:ro:")) != -1) {
+    switch (opt) {
+      case 'p':
+        prefixfile = optarg;
+        break;
+      case 'b':
+        bogonfile = optarg;
+        break;
+      case 'a':
+        asnfile = optarg;
+        break;
+      case 't':
+        c.nthreads = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        c.raw = 1;
+        break;
+      case 'o':
+        if (!strcmp(optarg, "csv"))
+          c.mode = OUT_CSV;
+        else if (!strcmp(optarg, "bin"))
+          c.mode = OUT_BIN;
+        else if (!strcmp(optarg, "prefix"))
+          c.mode = OUT_PREFIX;
+        else if (!strcmp(optarg, "asn"))
+          c.mode = OUT_ASN;
+        else
+          usage(basename(argv[0]));
+        break;
+      default:
+        usage(basename(argv[0]));
+    }
+  }
+
+  if (c.nthreads < 1 || c.nthreads > 1024)
+    usage(basename(argv[0]));
+
+  if (classify_load(&c, prefixfile, bogonfile, asnfile))
+    exit(EXIT_FAILURE);
+
+  c.nslots = c.nthreads * CLASSIFY_WINDOW;
+  pthread_mutex_init(&c.lock, NULL);
+  pthread_cond_init(&c.cond, NULL);
+  c.slots = (classify_chunk_t *) calloc(c.nslots, sizeof(classify_chunk_t));
+  c.carry = (char *) malloc(CLASSIFY_CHUNK);
+  workers = (classify_worker_t *) calloc(c.nthreads, sizeof(classify_worker_t));
+  if (!c.slots || !c.carry || !workers ||
+      (c.mode >= OUT_PREFIX && lct_acct_init(&c.acct, &c.trie, c.nthreads))) {
+    fprintf(stderr, "ERROR: failed to allocate classifier state\n");
+    exit(EXIT_FAILURE);
+  }
+  for (uint32_t i = 0; i < c.nthreads; ++i) {
+    workers[i].c = &c;
+    workers[i].id = i;
+  }
+
+  if (c.mode == OUT_CSV)
+    printf("addr,prefix,len,type,asn\n");
+  fflush(stdout);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (optind == argc) {
+    rc = classify_file(&c, workers, "-");
+  }
+  else {
+    for (int i = optind; i < argc && !rc; ++i)
+      rc = classify_file(&c, workers, argv[i]);
+  }
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  for (uint32_t i = 0; i < c.nthreads; ++i) {
+    c.naddrs += workers[i].naddrs;
+    c.ninvalid += workers[i].ninvalid;
+  }
+
+  if (!rc && c.mode >= OUT_PREFIX)
+    rc = report_counts(&c);
+  fflush(stdout);
+
+  fprintf(stderr, "classified %lu addresses (%lu invalid lines) from %lu bytes in %.3f s "
+          "on %u threads, %.2f M addresses/s, %.1f MB/s\n",
+          c.naddrs, c.ninvalid, c.nbytes, elapsed, c.nthreads,
+          elapsed > 0 ? c.naddrs / elapsed / 1e6 : 0,
+          elapsed > 0 ? c.nbytes / elapsed / 1e6 : 0);
+
+  for (uint32_t i = 0; i < c.nthreads; ++i) {
+    free(workers[i].keys);
+    free(workers[i].results);
+  }
+  for (uint32_t i = 0; i < c.nslots; ++i) {
+    free(c.slots[i].buf);
+    free(c.slots[i].out);
+  }
+  free(workers);
+  free(c.slots);
+  free(c.carry);
+  lct_acct_free(&c.acct);
+  for (int i = 0; i < c.nasns; ++i)
+    free(c.asns[i].desc);
+  free(c.asns);
+  free(c.trie.nets);
+  lct_free(&c.trie);
+  return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
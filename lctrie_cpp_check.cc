@@ -0,0 +1,193 @@
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <libgen.h>
+
+#include "lctrie.hpp"
+#include "lctrie_bgp.h"
+
+// C++ front end checker
+//
+// Builds the templated tries over the BGP table and checks every one of
+// them against lct_find_idx() over the C trie, on the edges of every subnet
+// and on random addresses, then times the inlined lookups against the C
+// ones.  The static table is checked by the compiler, and against a linear
+// scan at runtime.
+
+#define CPP_MAX_ENTRIES       4000000
+#define CPP_RANDOM_KEYS       10000000
+
+// the loopback and RFC1918 ranges, with a default route under them
+static constexpr auto special = lctrie::make_static_table<int>({
+  { 0x00000000,  0, IP_SUBNET_BGP },
+  { 0x7f000000,  8, IP_SUBNET_LOOPBACK },
+  { 0x0a000000,  8, IP_SUBNET_PRIVATE },
+  { 0xac100000, 12, IP_SUBNET_PRIVATE },
+  { 0xc0a80000, 16, IP_SUBNET_PRIVATE },
+  { 0xc0a80100, 24, IP_SUBNET_USER },
+});
+
+static_assert(*special.find(0x7f000001u) == IP_SUBNET_LOOPBACK, "loopback");
+static_assert(*special.find(0xc0a80001u) == IP_SUBNET_PRIVATE, "192.168.0.1");
+static_assert(*special.find(0xc0a801ffu) == IP_SUBNET_USER, "192.168.1.255");
+static_assert(*special.find(0xc0a80200u) == IP_SUBNET_PRIVATE, "192.168.2.0");
+static_assert(*special.find(0x08080808u) == IP_SUBNET_BGP, "8.8.8.8");
+static_assert(special.intervals() == 11, "folded intervals");
+
+static uint64_t seed = 88172645463325252ULL;
+
+static
+uint32_t xorshift(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (uint32_t) seed;
+}
+
+static
+double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the edges of every subnet and then random addresses
+static
+std::vector<uint32_t> check_keys(const std::vector<lct_subnet_t> &subnets) {
+  std::vector<uint32_t> keys;
+  uint32_t last;
+
+  for (const lct_subnet_t &s : subnets) {
+    last = s.addr | (uint32_t) (((uint64_t) 1 << (32 - s.len)) - 1);
+    keys.push_back(s.addr - 1);
+    keys.push_back(s.addr);
+    keys.push_back(last);
+    keys.push_back(last + 1);
+  }
+  for (uint32_t i = 0; i < CPP_RANDOM_KEYS; ++i)
+    keys.push_back(xorshift());
+
+  return keys;
+}
+
+// check a trie front end against the C lookup over the same subnets
+template <typename T, typename Convert>
+static
+int check_trie(const char *name, const T &t, lct_t *ref,
+               const std::vector<uint32_t> &keys, Convert convert) {
+  uint32_t want, got;
+  uint64_t sum = 0;
+  double start, cpp, c;
+
+  for (uint32_t key : keys) {
+    want = lct_find_idx(ref, key);
+    if (!T::resolve_prefixes && want != IP_PREFIX_NIL && ref->nets[want].type != IP_BASE)
+      want = IP_PREFIX_NIL;
+    got = t.find_idx(convert(key));
+    if (want != got) {
+      fprintf(stderr, "ERROR: %s mismatch at %08x, got %u expected %u\n",
+              name, key, got, want);
+      return -1;
+    }
+  }
+
+  start = now();
+  for (uint32_t key : keys)
+    sum += t.find_idx(convert(key));
+  cpp = now() - start;
+
+  start = now();
+  for (uint32_t key : keys)
+    sum += lct_find_idx(ref, key);
+  c = now() - start;
+
+  printf("%-36s ok, %.2f M lookups/s inlined, %.2f M lookups/s through lct_find_idx() (%lu)\n",
+         name, keys.size() / cpp / 1e6, keys.size() / c / 1e6, (unsigned long) (sum & 1));
+  return 0;
+}
+
+static
+int check_static(void) {
+  const lctrie::StaticEntry<int> *e = special.entries();
+  uint32_t key, want;
+  int best;
+
+  for (uint32_t i = 0; i < CPP_RANDOM_KEYS / 10; ++i) {
+    key = xorshift();
+    best = -1;
+    for (size_t j = 0; j < special.size(); ++j) {
+      if (lctrie::prefix_match(e[j].len, key ^ e[j].addr) && (best < 0 || e[j].len > e[best].len))
+        best = j;
+    }
+    want = (best < 0) ? IP_PREFIX_NIL : best;
+    if (special.find_idx(key) != want) {
+      fprintf(stderr, "ERROR: static table mismatch at %08x\n", key);
+      return -1;
+    }
+  }
+
+  printf("%-36s ok, %zu subnets in %zu intervals\n", "lctrie::StaticTable", special.size(),
+         special.intervals());
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *filename = (argc > 1) ? argv[1] : "bgp/data-raw-table";
+  std::vector<lct_subnet_t> subnets(CPP_MAX_ENTRIES);
+  std::vector<uint32_t> keys;
+  lct_t ref = {};
+  int num = 0, rc, failed = 0;
+
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [BGP prefixes file]\n", basename(argv[0]));
+    exit(EXIT_FAILURE);
+  }
+
+  num += init_private_subnets(&subnets[num], CPP_MAX_ENTRIES);
+  num += init_special_subnets(&subnets[num], CPP_MAX_ENTRIES - num);
+  if ((rc = read_prefix_table((char *) filename, &subnets[num], CPP_MAX_ENTRIES - num)) < 0) {
+    fprintf(stderr, "could not read prefix file \"%s\"\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  subnets.resize(num + rc);
+
+  try {
+    lctrie::Trie<> t16(subnets);
+    lctrie::Trie<uint32_t, 20> t20(subnets);
+    lctrie::Trie<uint32_t, 16, false> bases(subnets);
+    lctrie::Trie<in_addr, 8> net(subnets);
+
+    // the reference is the C trie built over the same prepared subnets
+    std::vector<lct_subnet_t> prepared(t16.subnets());
+    if (lct_build(&ref, prepared.data(), prepared.size())) {
+      fprintf(stderr, "ERROR: failed to build the reference trie\n");
+      exit(EXIT_FAILURE);
+    }
+    keys = check_keys(prepared);
+
+    auto host = [](uint32_t key) { return key; };
+    auto network = [](uint32_t key) { in_addr a; a.s_addr = htonl(key); return a; };
+
+    failed |= check_trie("lctrie::Trie<uint32_t, 16>", t16, &ref, keys, host);
+    failed |= check_trie("lctrie::Trie<uint32_t, 20>", t20, &ref, keys, host);
+    failed |= check_trie("lctrie::Trie<uint32_t, 16, false>", bases, &ref, keys, host);
+    failed |= check_trie("lctrie::Trie<in_addr, 8>", net, &ref, keys, network);
+
+    // moving a trie keeps it working
+    lctrie::Trie<> moved(std::move(t16));
+    failed |= check_trie("moved lctrie::Trie<>", moved, &ref, keys, host);
+
+    lct_free(&ref);
+  }
+  catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: %s\n", e.what());
+    exit(EXIT_FAILURE);
+  }
+
+  failed |= check_static();
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
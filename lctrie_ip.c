@@ -31,6 +31,51 @@ int subnet_isprefix(lct_subnet_t *s, lct_subnet_t *t) {
            EXTRACT(0, s->len, t->addr)));
 }
 
+int subnet_info_eq(const lct_subnet_info_t *a, const lct_subnet_info_t *b) {
+  if (a->type != b->type)
+    return 0;
+
+  switch (a->type) {
+    case IP_SUBNET_BGP:
+      return a->bgp.asn == b->bgp.asn;
+    case IP_SUBNET_PRIVATE:
+      return a->priv.class == b->priv.class;
+    case IP_SUBNET_RESERVED:
+      return a->rsv.desc == b->rsv.desc;
+    case IP_SUBNET_USER:
+      return a->usr.data == b->usr.data;
+    default:
+      return 1;
+  }
+}
+
+static inline
+uint32_t info_mix(uint32_t h, uint32_t v) {
+  h ^= v;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+uint32_t subnet_info_hash(uint32_t h, const lct_subnet_info_t *info) {
+  h = info_mix(h, info->type);
+  switch (info->type) {
+    case IP_SUBNET_BGP:
+      return info_mix(h, info->bgp.asn);
+    case IP_SUBNET_PRIVATE:
+      return info_mix(h, (uint8_t) info->priv.class);
+    case IP_SUBNET_RESERVED:
+      return info_mix(h, (uint32_t) (uintptr_t) info->rsv.desc);
+    case IP_SUBNET_USER:
+      return info_mix(h, (uint32_t) (uintptr_t) info->usr.data);
+    default:
+      return h;
+  }
+}
+
 void subnet_mask(lct_subnet_t *subnets, size_t size) {
   char pstr[INET_ADDRSTRLEN], pstr2[INET_ADDRSTRLEN];
   uint32_t prefix, prefix2;
@@ -66,7 +111,8 @@ size_t subnet_dedup(lct_subnet_t *subnets, size_t size) {
   uint32_t prefix;
   size_t ndup = 0;
 
-  for (int i = 0, j = 1; j < size; ++i, ++j) {
+  // i is the last subnet kept, j the next one to look at
+  for (size_t i = 0, j = 1; j < size; ++j) {
     // we have a duplicate!
     if (!subnet_cmp(&subnets[i], &subnets[j])) {
       prefix = htonl(subnets[i].addr);
@@ -80,13 +126,14 @@ size_t subnet_dedup(lct_subnet_t *subnets, size_t size) {
       // dis-allowing redefinition of that subnet elsewhere,
       // ex. bogon file, BGP ASN list, user specified subnets
       //
-      // slide the rest of the array over the second value.  if we're at the
-      // end of the array, just let it drop off.
-      if ((j + 1) < size)
-        memmove(&subnets[j], &subnets[j + 1], (size - (j + 1)) * sizeof(lct_subnet_t));
-      --size;
+      // drop the second value by leaving it behind as the rest of the
+      // array is slid down over it, so runs of several copies all go
       ++ndup;
+      continue;
     }
+
+    if (++i != j)
+      subnets[i] = subnets[j];
   }
 
   if (ndup)
@@ -128,6 +175,7 @@ size_t subnet_prefix(lct_subnet_t *p, lct_ip_stats_t *stats, size_t size) {
   // everything on an initial walk through the array.
   for (int i = 0; i < size; ++i) {
     p[i].prefix = IP_PREFIX_NIL;
+    p[i].fullprefix = IP_PREFIX_NIL;
   }
 
   // go through and determine which subnets are prefixes of other subnets
@@ -399,3 +447,287 @@ int init_special_subnets(lct_subnet_t *subnets, size_t size) {
 
   return num;
 }
+
+// ORTC route aggregation
+//
+// The subnets are loaded into a binary trie and aggregated in the three
+// passes of Draves et al., Constructing Optimal IP Routing Tables:
+//
+// 1. every interior node gets both children, a new leaf inheriting the
+//    attribute of its closest subnet, so the leaves tile the address space
+// 2. bottom up, a leaf's candidate set is its attribute, and an interior
+//    node's is the intersection of its children's sets, or their union if
+//    that's empty
+// 3. top down, a node whose parent's choice is in its set doesn't need a
+//    subnet, otherwise it gets one for some attribute of its set
+//
+// Addresses without any match have to come out without a match, and there
+// is no subnet meaning "no match" to put under one that does, so a set
+// taking the union with no match is left as no match only.  No match then
+// only ever shows up on its own, and only under nodes that chose it too.
+
+// projected attribute ids, with no match at all sorting first
+#define AGG_NONE        0
+#define AGG_UNSET       UINT32_MAX
+
+typedef struct agg_node {
+  uint32_t child[2];
+  uint32_t hop;           // attribute id of the subnet here, or AGG_UNSET
+  uint32_t off;           // candidate set in the set buffer, or the one
+  uint32_t len;           // candidate itself when there's only one
+} agg_node_t;
+
+typedef struct agg {
+  int proj;
+  uint64_t *keys;         // distinct projected keys, attribute id - 1
+  uint32_t nkeys;
+  agg_node_t *nodes;
+  uint32_t ncount, ncap;
+  uint32_t *sets;
+  uint32_t setlen, setcap;
+  lct_subnet_t *out;
+  uint32_t nout, outcap;
+} agg_t;
+
+static inline
+uint64_t agg_key(const lct_subnet_info_t *info, int proj) {
+  return ((uint64_t) info->type << 32) |
+         ((proj == IP_PROJ_ASN && info->type == IP_SUBNET_BGP) ? info->bgp.asn : 0);
+}
+
+static
+int agg_key_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+static
+uint32_t agg_id(const agg_t *a, uint64_t key) {
+  uint32_t lo = 0, hi = a->nkeys, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (a->keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo + 1;
+}
+
+static
+int agg_grow(void **arr, uint32_t *cap, uint64_t need, size_t size) {
+  uint64_t newcap = *cap ? *cap : 4096;
+  void *grown;
+
+  if (need <= *cap)
+    return 0;
+  while (newcap < need)
+    newcap *= 2;
+  if (newcap > UINT32_MAX || !(grown = realloc(*arr, newcap * size)))
+    return -1;
+  *arr = grown;
+  *cap = newcap;
+  return 0;
+}
+
+static
+uint32_t agg_node(agg_t *a, uint32_t hop) {
+  if (agg_grow((void **) &a->nodes, &a->ncap, (uint64_t) a->ncount + 1, sizeof(agg_node_t)))
+    return AGG_UNSET;
+
+  a->nodes[a->ncount].child[0] = AGG_UNSET;
+  a->nodes[a->ncount].child[1] = AGG_UNSET;
+  a->nodes[a->ncount].hop = hop;
+  a->nodes[a->ncount].off = 0;
+  a->nodes[a->ncount].len = 0;
+  return a->ncount++;
+}
+
+static inline
+const uint32_t *agg_set(const agg_t *a, const agg_node_t *n) {
+  return (n->len == 1) ? &n->off : &a->sets[n->off];
+}
+
+// pass 1 and 2 together, filling in the missing children on the way down
+static
+int agg_merge(agg_t *a, uint32_t n, uint32_t inherited) {
+  uint32_t h, c[2], la, lb, i, j, k, *out;
+  const uint32_t *sa, *sb;
+
+  h = (a->nodes[n].hop != AGG_UNSET) ? a->nodes[n].hop : inherited;
+  if (a->nodes[n].child[0] == AGG_UNSET && a->nodes[n].child[1] == AGG_UNSET) {
+    a->nodes[n].off = h;
+    a->nodes[n].len = 1;
+    return 0;
+  }
+
+  for (i = 0; i < 2; ++i) {
+    if (a->nodes[n].child[i] == AGG_UNSET) {
+      if (AGG_UNSET == (c[i] = agg_node(a, AGG_UNSET)))
+        return -1;
+      a->nodes[n].child[i] = c[i];
+    }
+    c[i] = a->nodes[n].child[i];
+    if (agg_merge(a, c[i], h))
+      return -1;
+  }
+
+  la = a->nodes[c[0]].len;
+  lb = a->nodes[c[1]].len;
+  if (agg_grow((void **) &a->sets, &a->setcap, (uint64_t) a->setlen + la + lb, sizeof(uint32_t)))
+    return -1;
+  sa = agg_set(a, &a->nodes[c[0]]);
+  sb = agg_set(a, &a->nodes[c[1]]);
+  out = &a->sets[a->setlen];
+
+  // intersection of the sorted sets
+  for (i = j = k = 0; i < la && j < lb;) {
+    if (sa[i] < sb[j])
+      ++i;
+    else if (sa[i] > sb[j])
+      ++j;
+    else {
+      out[k++] = sa[i];
+      ++i;
+      ++j;
+    }
+  }
+
+  // otherwise the union, unless one side misses
+  if (!k && (sa[0] == AGG_NONE || sb[0] == AGG_NONE)) {
+    out[k++] = AGG_NONE;
+  }
+  else if (!k) {
+    for (i = j = 0; i < la || j < lb;) {
+      if (j == lb || (i < la && sa[i] < sb[j]))
+        out[k++] = sa[i++];
+      else if (i == la || sb[j] < sa[i])
+        out[k++] = sb[j++];
+      else {
+        out[k++] = sa[i++];
+        ++j;
+      }
+    }
+  }
+
+  if (k == 1) {
+    a->nodes[n].off = out[0];
+  }
+  else {
+    a->nodes[n].off = a->setlen;
+    a->setlen += k;
+  }
+  a->nodes[n].len = k;
+  return 0;
+}
+
+// pass 3, writing out the subnets in sorted order
+static
+int agg_emit(agg_t *a, uint32_t n, uint32_t inherited, uint32_t addr, uint8_t len) {
+  const uint32_t *set = agg_set(a, &a->nodes[n]);
+  uint32_t lo = 0, hi = a->nodes[n].len, mid, chosen = inherited;
+  uint64_t key;
+  lct_subnet_t *s;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (set[mid] < inherited)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == a->nodes[n].len || set[lo] != inherited) {
+    chosen = set[0];
+    if (agg_grow((void **) &a->out, &a->outcap, (uint64_t) a->nout + 1, sizeof(lct_subnet_t)))
+      return -1;
+
+    key = a->keys[chosen - 1];
+    s = &a->out[a->nout++];
+    memset(s, 0, sizeof(lct_subnet_t));
+    s->addr = addr;
+    s->len = len;
+    s->info.type = key >> 32;
+    if (s->info.type == IP_SUBNET_BGP)
+      s->info.bgp.asn = (uint32_t) key;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (a->nodes[n].child[i] != AGG_UNSET &&
+        agg_emit(a, a->nodes[n].child[i], chosen, addr | ((uint32_t) i << (31 - len)), len + 1))
+      return -1;
+  }
+
+  return 0;
+}
+
+// aggregate into a->out, returning 0 on success
+static
+int agg_run(agg_t *a, const lct_subnet_t *subnets, uint32_t size) {
+  uint32_t n, i, k, bit, c;
+
+  // number the distinct projections
+  if (!(a->keys = (uint64_t *) malloc((size + 1) * sizeof(uint64_t))))
+    return -1;
+  for (i = 0; i < size; ++i)
+    a->keys[i] = agg_key(&subnets[i].info, a->proj);
+  qsort(a->keys, size, sizeof(uint64_t), agg_key_cmp);
+  for (i = 0; i < size; ++i)
+    if (!a->nkeys || a->keys[a->nkeys - 1] != a->keys[i])
+      a->keys[a->nkeys++] = a->keys[i];
+
+  // load the binary trie, leaving out the full prefixes nothing can match
+  if (AGG_UNSET == agg_node(a, AGG_UNSET))
+    return -1;
+  for (i = 0; i < size; ++i) {
+    if (subnets[i].type == IP_PREFIX_FULL)
+      continue;
+    for (n = 0, k = 0; k < subnets[i].len; ++k) {
+      bit = (subnets[i].addr >> (31 - k)) & 1;
+      if (a->nodes[n].child[bit] == AGG_UNSET) {
+        if (AGG_UNSET == (c = agg_node(a, AGG_UNSET)))
+          return -1;
+        a->nodes[n].child[bit] = c;
+      }
+      n = a->nodes[n].child[bit];
+    }
+    a->nodes[n].hop = agg_id(a, agg_key(&subnets[i].info, a->proj));
+  }
+
+  return (agg_merge(a, 0, AGG_NONE) || agg_emit(a, 0, AGG_NONE, 0, 0)) ? -1 : 0;
+}
+
+int subnet_aggregate(lct_subnet_t *subnets, size_t size, int proj) {
+  lct_ip_stats_t *stats = NULL;
+  agg_t a;
+  int rc = -1;
+
+  if (!subnets || (proj != IP_PROJ_TYPE && proj != IP_PROJ_ASN) || size >= INT32_MAX)
+    return -1;
+
+  memset(&a, 0, sizeof(agg_t));
+  a.proj = proj;
+  if (agg_run(&a, subnets, size)) {
+    fprintf(stderr, "ERROR: failed to aggregate subnets\n");
+  }
+  else if (a.nout > size) {
+    // can't happen, the input is a valid aggregate itself
+    fprintf(stderr, "ERROR: aggregated %lu subnets into %u\n", (unsigned long) size, a.nout);
+  }
+  else if (a.nout && !(stats = (lct_ip_stats_t *) calloc(a.nout, sizeof(lct_ip_stats_t)))) {
+    fprintf(stderr, "ERROR: failed to allocate aggregate prefix statistics\n");
+  }
+  else {
+    memcpy(subnets, a.out, a.nout * sizeof(lct_subnet_t));
+    subnet_prefix(subnets, stats, a.nout);
+    rc = a.nout;
+  }
+
+  free(stats);
+  free(a.out);
+  free(a.sets);
+  free(a.nodes);
+  free(a.keys);
+  return rc;
+}
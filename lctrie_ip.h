@@ -5,6 +5,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define IP_SUBNET_UNUSED      0
 #define IP_SUBNET_BGP         1
 #define IP_SUBNET_PRIVATE     2
@@ -37,7 +41,11 @@ typedef struct lct_subnet_bgp_t {
 // RFC1918 private IP subnets have a
 typedef struct lct_subnet_private_t {
   uint32_t type;
+#ifdef __cplusplus
+  char cls;   // class is reserved in C++, same field
+#else
   char class;
+#endif
 } lct_subnet_private_t;
 
 // RFC5735 reserved IP subnets
@@ -121,10 +129,34 @@ extern size_t subnet_dedup(lct_subnet_t *subnets, size_t size);
 // and returns the number found
 extern size_t subnet_prefix(lct_subnet_t *subnets, lct_ip_stats_t *stats, size_t size);
 
+// attribute projections for subnet_aggregate()
+#define IP_PROJ_TYPE    0   // the subnet info type only
+#define IP_PROJ_ASN     1   // the type, and the ASN of BGP subnets
+
+// aggregates a sorted and prefixed subnet array down to the fewest subnets
+// giving every address the same projection of its longest prefix match's
+// info, and the same misses.  the aggregated subnets are written back over
+// the array sorted and prefixed, ready for lct_build(), with only the
+// projected fields of their info filled in.  full prefixes are dropped
+// since nothing can match them.
+// returns the number of subnets left, or negative on failure
+extern int subnet_aggregate(lct_subnet_t *subnets, size_t size, int proj);
+
 // is subnet s a prefix of the subnet t?
 // requires the two elements to be sorted and in order according
 // to subnet_cmp
 extern int subnet_isprefix(lct_subnet_t *s, lct_subnet_t *t);
 
+// are two subnet info values the same?  compares the fields of their type
+// only, so whatever is left over in the rest of the union doesn't matter
+extern int subnet_info_eq(const lct_subnet_info_t *a, const lct_subnet_info_t *b);
+
+// hash of a subnet info value mixed into h, consistent with subnet_info_eq
+extern uint32_t subnet_info_hash(uint32_t h, const lct_subnet_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
 // end #ifndef guard
 #endif
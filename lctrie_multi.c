@@ -0,0 +1,416 @@
+#include "lctrie_multi.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// initial log2 slots of each hash set
+#define MULTI_SET_BITS    10
+
+// per table state while adding it to the arena
+typedef struct multi_add {
+  lct_multi_t *multi;
+  lct_t *trie;            // the table built on its own
+  uint32_t *linkof;       // arena link of each of the table's subnets
+} multi_add_t;
+
+typedef int (*set_eq_t)(const lct_multi_t *multi, uint32_t id, const void *query);
+
+static inline
+uint32_t mix(uint32_t h, uint32_t v) {
+  h ^= v;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+static
+int set_init(lct_multi_set_t *set, uint32_t bits) {
+  set->mask = (1U << bits) - 1;
+  set->count = 0;
+  set->ids = (uint32_t *) malloc((set->mask + 1) * sizeof(uint32_t));
+  set->hashes = (uint32_t *) malloc((set->mask + 1) * sizeof(uint32_t));
+  if (!set->ids || !set->hashes) {
+    free(set->ids);
+    free(set->hashes);
+    set->ids = set->hashes = NULL;
+    return -1;
+  }
+  memset(set->ids, 0xff, (set->mask + 1) * sizeof(uint32_t));
+  return 0;
+}
+
+static
+void set_free(lct_multi_set_t *set) {
+  free(set->ids);
+  free(set->hashes);
+  set->ids = set->hashes = NULL;
+}
+
+// slot holding the entry equal to the query, or the empty slot it goes in
+static
+uint32_t set_slot(const lct_multi_t *multi, const lct_multi_set_t *set, uint32_t hash,
+                  set_eq_t eq, const void *query) {
+  uint32_t i = hash & set->mask;
+
+  while (set->ids[i] != LCT_MULTI_NIL) {
+    if (set->hashes[i] == hash && eq(multi, set->ids[i], query))
+      break;
+    i = (i + 1) & set->mask;
+  }
+
+  return i;
+}
+
+// make room for one more entry, keeping the set at most half full
+static
+int set_reserve(lct_multi_set_t *set) {
+  lct_multi_set_t grown;
+  uint32_t bits = 0, i, j;
+
+  if (2 * (set->count + 1) <= set->mask + 1)
+    return 0;
+
+  while ((1U << bits) <= set->mask)
+    ++bits;
+  if (bits >= 31 || set_init(&grown, bits + 1))
+    return -1;
+
+  // entries are only ever equal to themselves, so they just need a free slot
+  for (i = 0; i <= set->mask; ++i) {
+    if (set->ids[i] == LCT_MULTI_NIL)
+      continue;
+    for (j = set->hashes[i] & grown.mask; grown.ids[j] != LCT_MULTI_NIL; j = (j + 1) & grown.mask);
+    grown.ids[j] = set->ids[i];
+    grown.hashes[j] = set->hashes[i];
+  }
+  grown.count = set->count;
+
+  set_free(set);
+  *set = grown;
+  return 0;
+}
+
+// make sure an arena array has room for need elements, doubling it as needed
+static
+int arena_reserve(void **arr, uint32_t *cap, uint64_t need, size_t size) {
+  uint64_t newcap = *cap ? *cap : 1024;
+  void *grown;
+
+  if (need <= *cap)
+    return 0;
+
+  while (newcap < need)
+    newcap *= 2;
+  if (newcap > UINT32_MAX || !(grown = realloc(*arr, newcap * size)))
+    return -1;
+
+  *arr = grown;
+  *cap = (uint32_t) newcap;
+  return 0;
+}
+
+static
+int net_eq(const lct_multi_t *multi, uint32_t id, const void *query) {
+  const lct_subnet_t *a = &multi->nets[id], *b = (const lct_subnet_t *) query;
+
+  return a->addr == b->addr && a->len == b->len && subnet_info_eq(&a->info, &b->info);
+}
+
+static
+int link_eq(const lct_multi_t *multi, uint32_t id, const void *query) {
+  const lct_multi_link_t *a = &multi->links[id], *b = (const lct_multi_link_t *) query;
+
+  return a->net == b->net && a->next == b->next;
+}
+
+// a block query, the child nodes and how many there are
+typedef struct multi_block {
+  uint32_t n;
+  const lct_node_t *nodes;
+} multi_block_t;
+
+static
+int block_eq(const lct_multi_t *multi, uint32_t id, const void *query) {
+  const multi_block_t *b = (const multi_block_t *) query;
+  const lct_node_t *a = &multi->nodes[id];
+
+  // the hash covers the block size, so this is normally a block of the
+  // same size, but a collision can land anywhere, so never compare past
+  // the end of the arena.  nodes matching across two stored blocks are
+  // still the right nodes, so that's as good as a match of one.
+  if ((uint64_t) id + b->n > multi->ncount)
+    return 0;
+  for (uint32_t i = 0; i < b->n; ++i) {
+    if (a[i].branch != b->nodes[i].branch || a[i].skip != b->nodes[i].skip ||
+        a[i].index != b->nodes[i].index)
+      return 0;
+  }
+
+  return 1;
+}
+
+// arena index of a subnet, interning a copy of it if it's new
+static
+uint32_t intern_net(lct_multi_t *multi, const lct_subnet_t *subnet) {
+  uint32_t hash, slot;
+
+  if (set_reserve(&multi->netset))
+    return LCT_MULTI_NIL;
+
+  hash = subnet_info_hash(mix(mix(0, subnet->addr), subnet->len), &subnet->info);
+  slot = set_slot(multi, &multi->netset, hash, net_eq, subnet);
+  if (multi->netset.ids[slot] != LCT_MULTI_NIL)
+    return multi->netset.ids[slot];
+
+  if (arena_reserve((void **) &multi->nets, &multi->netcap, (uint64_t) multi->nnets + 1,
+                    sizeof(lct_subnet_t)))
+    return LCT_MULTI_NIL;
+
+  // the prefix links belong to the tables, not the subnet
+  multi->nets[multi->nnets] = *subnet;
+  multi->nets[multi->nnets].type = IP_BASE;
+  multi->nets[multi->nnets].prefix = IP_PREFIX_NIL;
+  multi->nets[multi->nnets].fullprefix = IP_PREFIX_NIL;
+
+  multi->netset.ids[slot] = multi->nnets;
+  multi->netset.hashes[slot] = hash;
+  ++multi->netset.count;
+  return multi->nnets++;
+}
+
+// arena index of the chain cell of a subnet in front of the next cell
+static
+uint32_t intern_link(lct_multi_t *multi, uint32_t net, uint32_t next) {
+  lct_multi_link_t link;
+  uint32_t hash, slot;
+
+  if (set_reserve(&multi->linkset))
+    return LCT_MULTI_NIL;
+
+  link.addr = multi->nets[net].addr;
+  link.mask = (uint32_t) ~(0xffffffffULL >> multi->nets[net].len);
+  link.net = net;
+  link.next = next;
+
+  hash = mix(mix(0, net), next);
+  slot = set_slot(multi, &multi->linkset, hash, link_eq, &link);
+  if (multi->linkset.ids[slot] != LCT_MULTI_NIL)
+    return multi->linkset.ids[slot];
+
+  if (arena_reserve((void **) &multi->links, &multi->linkcap, (uint64_t) multi->nlinks + 1,
+                    sizeof(lct_multi_link_t)))
+    return LCT_MULTI_NIL;
+
+  multi->links[multi->nlinks] = link;
+  multi->linkset.ids[slot] = multi->nlinks;
+  multi->linkset.hashes[slot] = hash;
+  ++multi->linkset.count;
+  return multi->nlinks++;
+}
+
+// arena index of a block of child nodes
+static
+uint32_t intern_block(lct_multi_t *multi, const lct_node_t *nodes, uint32_t n) {
+  multi_block_t block = { n, nodes };
+  uint32_t hash = mix(0, n), slot;
+
+  if (set_reserve(&multi->blockset))
+    return LCT_MULTI_NIL;
+
+  for (uint32_t i = 0; i < n; ++i)
+    hash = mix(mix(hash, nodes[i].index), nodes[i].branch | (nodes[i].skip << 8));
+  slot = set_slot(multi, &multi->blockset, hash, block_eq, &block);
+  if (multi->blockset.ids[slot] != LCT_MULTI_NIL)
+    return multi->blockset.ids[slot];
+
+  if (arena_reserve((void **) &multi->nodes, &multi->ncap, (uint64_t) multi->ncount + n,
+                    sizeof(lct_node_t)))
+    return LCT_MULTI_NIL;
+
+  memcpy(&multi->nodes[multi->ncount], nodes, n * sizeof(lct_node_t));
+  multi->blockset.ids[slot] = multi->ncount;
+  multi->blockset.hashes[slot] = hash;
+  ++multi->blockset.count;
+  multi->ncount += n;
+  return multi->blockset.ids[slot];
+}
+
+// arena chain of a subnet of the table and all of its non-full prefixes
+static
+uint32_t add_chain(multi_add_t *add, uint32_t idx) {
+  uint32_t next = LCT_MULTI_NIL, net;
+
+  if (add->linkof[idx] != LCT_MULTI_NIL)
+    return add->linkof[idx];
+
+  if (add->trie->nets[idx].prefix != IP_PREFIX_NIL &&
+      LCT_MULTI_NIL == (next = add_chain(add, add->trie->nets[idx].prefix)))
+    return LCT_MULTI_NIL;
+  if (LCT_MULTI_NIL == (net = intern_net(add->multi, &add->trie->nets[idx])))
+    return LCT_MULTI_NIL;
+
+  return add->linkof[idx] = intern_link(add->multi, net, next);
+}
+
+// translate one of the table's trie nodes into the arena, children first
+// so that identical sub-tries come out as identical blocks
+static
+int add_node(multi_add_t *add, uint32_t pos, lct_node_t *out) {
+  const lct_node_t *node = &add->trie->root[pos];
+  lct_node_t small[16], *children;
+  uint32_t n, i;
+  int rc = 0;
+
+  out->branch = node->branch;
+  out->skip = node->skip;
+
+  if (!node->branch) {
+    out->index = add_chain(add, add->trie->bases[node->index]);
+    return (out->index == LCT_MULTI_NIL) ? -1 : 0;
+  }
+
+  n = 1U << node->branch;
+  children = (n <= 16) ? small : (lct_node_t *) malloc(n * sizeof(lct_node_t));
+  if (!children)
+    return -1;
+  memset(children, 0, n * sizeof(lct_node_t));
+
+  for (i = 0; i < n && !rc; ++i)
+    rc = add_node(add, node->index + i, &children[i]);
+  if (!rc && LCT_MULTI_NIL == (out->index = intern_block(add->multi, children, n)))
+    rc = -1;
+
+  if (children != small)
+    free(children);
+  return rc;
+}
+
+int lct_multi_init(lct_multi_t *multi) {
+  if (!multi)
+    return -1;
+
+  memset(multi, 0, sizeof(lct_multi_t));
+  if (set_init(&multi->netset, MULTI_SET_BITS) ||
+      set_init(&multi->linkset, MULTI_SET_BITS) ||
+      set_init(&multi->blockset, MULTI_SET_BITS)) {
+    lct_multi_free(multi);
+    fprintf(stderr, "ERROR: failed to allocate multi-table indexes\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+void lct_multi_free(lct_multi_t *multi) {
+  if (!multi)
+    return;
+
+  set_free(&multi->netset);
+  set_free(&multi->linkset);
+  set_free(&multi->blockset);
+  free(multi->nets);
+  free(multi->links);
+  free(multi->nodes);
+  free(multi->roots);
+  memset(multi, 0, sizeof(lct_multi_t));
+}
+
+int lct_multi_add(lct_multi_t *multi, lct_subnet_t *subnets, uint32_t size,
+                  const lct_opts_t *opts) {
+  multi_add_t add;
+  lct_node_t root;
+  lct_t trie;
+  int rc;
+
+  if (!multi || !multi->netset.ids || !subnets || !size)
+    return -1;
+
+  // only the shape of the trie makes it into the arena, so the options
+  // adding lookup side structures or reordering the nodes can't be had
+  if (opts && (opts->attrs || opts->filter_bits || opts->asn_index ||
+               opts->layout != LCT_LAYOUT_DFS)) {
+    fprintf(stderr, "ERROR: trie option not supported by multi-table tries\n");
+    return -1;
+  }
+
+  if (arena_reserve((void **) &multi->roots, &multi->tablecap, (uint64_t) multi->ntables + 1,
+                    sizeof(lct_node_t))) {
+    fprintf(stderr, "ERROR: failed to allocate multi-table roots\n");
+    return -1;
+  }
+
+  // build the table on its own, then hash cons it into the arena
+  memset(&trie, 0, sizeof(lct_t));
+  if (lct_build_opts(&trie, subnets, size, opts))
+    return -1;
+
+  add.multi = multi;
+  add.trie = &trie;
+  if (!(add.linkof = (uint32_t *) malloc(size * sizeof(uint32_t)))) {
+    lct_free(&trie);
+    fprintf(stderr, "ERROR: failed to allocate multi-table link buffer\n");
+    return -1;
+  }
+  memset(add.linkof, 0xff, size * sizeof(uint32_t));
+
+  rc = add_node(&add, 0, &root);
+  if (!rc) {
+    multi->roots[multi->ntables] = root;
+    multi->unshared += trie.ncount * sizeof(lct_node_t) + trie.bcount * sizeof(uint32_t) +
+                       size * (sizeof(lct_subnet_t) + (trie.hot ? sizeof(lct_hot_t) : 0));
+  }
+  else {
+    fprintf(stderr, "ERROR: failed to grow the multi-table arena\n");
+  }
+
+  free(add.linkof);
+  lct_free(&trie);
+  return rc ? -1 : (int) multi->ntables++;
+}
+
+lct_subnet_t *lct_multi_find(lct_multi_t *multi, uint32_t table, uint32_t key) {
+  const lct_node_t *node;
+  const lct_multi_link_t *link;
+  int pos, branch;
+  uint32_t idx;
+
+  // idiot check
+  if (!multi || table >= multi->ntables)
+    return NULL;
+
+  // Traverse the table's trie through the shared nodes
+  node = &multi->roots[table];
+  pos = node->skip;
+  branch = node->branch;
+  idx = node->index;
+  while (branch != 0) {
+    node = &multi->nodes[idx + EXTRACT(pos, branch, key)];
+    pos += branch + node->skip;
+    branch = node->branch;
+    idx = node->index;
+  }
+
+  // the leaf's chain has its base and then its prefixes
+  for (; idx != LCT_MULTI_NIL; idx = link->next) {
+    link = &multi->links[idx];
+    if (((link->addr ^ key) & link->mask) == 0)
+      return &multi->nets[link->net];
+  }
+
+  return NULL;
+}
+
+size_t lct_multi_bytes(const lct_multi_t *multi) {
+  if (!multi)
+    return 0;
+
+  return multi->nnets * sizeof(lct_subnet_t) +
+         multi->nlinks * sizeof(lct_multi_link_t) +
+         multi->ncount * sizeof(lct_node_t) +
+         multi->ntables * sizeof(lct_node_t) +
+         (multi->netset.mask + 1 + multi->linkset.mask + 1 + multi->blockset.mask + 1) *
+           2 * sizeof(uint32_t);
+}
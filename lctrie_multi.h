@@ -0,0 +1,110 @@
+#ifndef __LC_TRIE_MULTI_H__
+#define __LC_TRIE_MULTI_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Multi-table tries sharing one arena
+//
+// Every tenant or VRF gets its own subnet table, but most of those tables
+// are the same RFC and BGP data with a handful of user subnets layered on
+// top.  A multi-table container stores the tries of all of the tables in
+// one shared arena, and hash conses everything going into it so identical
+// pieces are only ever stored once:
+//
+// nets   - the subnets themselves, by address, length, and subnet info.
+//          the arena's copies have no prefix links, since whether a subnet
+//          is a base or a prefix, and what its prefixes are, depends on the
+//          table it's in.
+// links  - a leaf's chain of subnets to match, the base followed by its
+//          non-full prefixes, as cons cells of a subnet and the next cell.
+//          tables agreeing on a base's covering prefixes share its chain.
+// nodes  - blocks of child nodes.  the tries are built bottom up, so two
+//          sub-tries with the same shape and the same leaf chains end up
+//          with the same child block, and any tables routing the same
+//          address range the same way share the whole sub-trie.
+//
+// The arena only grows, so the memory used scales with the differences
+// between the tables rather than with the number of tables, though every
+// table that differs anywhere at all pays for a root block of its own.  Tables are
+// added one at a time and looked up by the table id handed back.  Adding
+// tables isn't safe while looking up in others, since the arena may move.
+
+#define LCT_MULTI_NIL     UINT32_MAX
+
+// a cell of an interned prefix chain
+typedef struct lct_multi_link {
+  uint32_t addr;          // subnet address
+  uint32_t mask;          // subnet mask, so len 0 needs no special case
+  uint32_t net;           // index of the subnet in the arena nets
+  uint32_t next;          // next cell towards the shortest prefix, or
+                          // LCT_MULTI_NIL at the end of the chain
+} lct_multi_link_t;
+
+// open addressed hash set of arena indexes
+typedef struct lct_multi_set {
+  uint32_t *ids;          // arena indexes, LCT_MULTI_NIL for empty slots
+  uint32_t *hashes;       // hash of each slot's entry
+  uint32_t mask;          // number of slots - 1
+  uint32_t count;         // slots in use
+} lct_multi_set_t;
+
+typedef struct lct_multi {
+  // the shared arena
+  lct_subnet_t *nets;
+  uint32_t nnets, netcap;
+  lct_multi_link_t *links;
+  uint32_t nlinks, linkcap;
+  lct_node_t *nodes;
+  uint32_t ncount, ncap;
+
+  // root node of each table, by table id
+  lct_node_t *roots;
+  uint32_t ntables, tablecap;
+
+  // hash consing indexes into the arena
+  lct_multi_set_t netset;
+  lct_multi_set_t linkset;
+  lct_multi_set_t blockset;
+
+  // bytes the tables would have taken as separate tries, each with its
+  // own subnet array
+  uint64_t unshared;
+} lct_multi_t;
+
+// set up an empty container
+extern int lct_multi_init(lct_multi_t *multi);
+extern void lct_multi_free(lct_multi_t *multi);
+
+// add a table built from a prepared subnet array, the same as lct_build()
+// takes.  the subnets are copied into the arena, so the array may be freed
+// or reused afterwards.  returns the new table's id, or negative on failure.
+// of the build options only root_branch, fill, budget and profile, which
+// shape the trie, carry over into the arena, and alloc is only used for the
+// table's build on its own.  attrs, filter_bits, asn_index, and any layout
+// but LCT_LAYOUT_DFS are rejected.
+extern int lct_multi_add(lct_multi_t *multi, lct_subnet_t *subnets, uint32_t size,
+                         const lct_opts_t *opts);
+
+// trie search function in one of the tables
+// return the arena subnet corresponding to the element,
+// otherwise return NULL if not found or the table doesn't exist
+// key must be provided in host byte ordering
+extern lct_subnet_t *lct_multi_find(lct_multi_t *multi, uint32_t table, uint32_t key);
+
+// bytes of arena and index memory used by the container
+extern size_t lct_multi_bytes(const lct_multi_t *multi);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
@@ -0,0 +1,358 @@
+// sched_getcpu()
+#define _GNU_SOURCE
+
+#include "lctrie_numa.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <sys/syscall.h>
+
+// from linux/mempolicy.h, so we don't need libnuma just for mbind()
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED    1
+#endif
+
+#define SYSFS_NODE_DIR    "/sys/devices/system/node"
+
+// prefer the replica's node for its pages rather than strictly binding
+// them, so a fake topology or an exhausted node still gets memory.
+// only complain once, a fake topology would fail every single time.
+static
+void numa_bind(void *ptr, size_t size, uint32_t node) {
+  static int warned = 0;
+  unsigned long mask;
+  size_t pagesize = sysconf(_SC_PAGESIZE);
+
+  // a single word node mask is plenty for any machine we'll run on
+  if (!ptr || node >= 8 * sizeof(mask))
+    return;
+
+  mask = 1UL << node;
+  size = (size + pagesize - 1) & ~(pagesize - 1);
+  if (syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, &mask, 8 * sizeof(mask), 0) &&
+      !warned) {
+    fprintf(stderr, "WARNING: could not bind replica memory to node %u: %s\n",
+            node, strerror(errno));
+    warned = 1;
+  }
+}
+
+// node local allocations sit on top of the huge page allocator, binding
+// the mapping to the node before anything touches its pages.
+static
+void *numa_malloc(void *ctx, size_t size) {
+  lct_numa_node_t *n = (lct_numa_node_t *) ctx;
+  void *ptr;
+
+  ptr = lct_hugepage_allocator.malloc(lct_hugepage_allocator.ctx, size);
+  numa_bind(ptr, size, n->node);
+  return ptr;
+}
+
+static
+void numa_free(void *ctx, void *ptr, size_t size) {
+  lct_hugepage_allocator.free(lct_hugepage_allocator.ctx, ptr, size);
+}
+
+static
+void *numa_realloc(void *ctx, void *ptr, size_t oldsize, size_t size) {
+  void *newptr;
+
+  if (!(newptr = numa_malloc(ctx, size)))
+    return NULL;
+
+  memcpy(newptr, ptr, (size < oldsize) ? size : oldsize);
+  numa_free(ctx, ptr, oldsize);
+  return newptr;
+}
+
+// parse a sysfs cpulist such as "0-3,8-11" and assign those cpus to node
+static
+void parse_cpulist(const char *list, uint32_t node, uint32_t *cpu_node, uint32_t ncpus) {
+  const char *s = list;
+  char *end;
+  unsigned long lo, hi;
+
+  while (*s) {
+    lo = strtoul(s, &end, 10);
+    if (end == s)
+      break;
+    hi = lo;
+    s = end;
+    if (*s == '-') {
+      hi = strtoul(s + 1, &end, 10);
+      s = end;
+    }
+    for (unsigned long cpu = lo; cpu <= hi && cpu < ncpus; ++cpu)
+      cpu_node[cpu] = node;
+    if (*s == ',')
+      ++s;
+    else
+      break;
+  }
+}
+
+// read the machine's topology out of sysfs.  anything we can't make sense
+// of gets treated as a single node machine.
+static
+int detect_topology(lct_numa_t *numa) {
+  DIR *dir;
+  struct dirent *ent;
+  char path[512], list[4096];
+  FILE *f;
+  unsigned int node;
+  long ncpus;
+
+  if ((ncpus = sysconf(_SC_NPROCESSORS_CONF)) < 1)
+    ncpus = 1;
+
+  numa->ncpus = ncpus;
+  numa->nnodes = 1;
+  if (!(numa->cpu_node = (uint32_t *) calloc(ncpus, sizeof(uint32_t))))
+    return -1;
+
+  if (!(dir = opendir(SYSFS_NODE_DIR)))
+    return 0;
+
+  while ((ent = readdir(dir))) {
+    if (1 != sscanf(ent->d_name, "node%u", &node))
+      continue;
+
+    snprintf(path, sizeof(path), SYSFS_NODE_DIR "/%s/cpulist", ent->d_name);
+    if (!(f = fopen(path, "r")))
+      continue;
+
+    if (fgets(list, sizeof(list), f)) {
+      list[strcspn(list, "\n")] = 0;
+      parse_cpulist(list, node, numa->cpu_node, numa->ncpus);
+      if (node + 1 > numa->nnodes)
+        numa->nnodes = node + 1;
+    }
+    fclose(f);
+  }
+  closedir(dir);
+
+  return 0;
+}
+
+int lct_numa_init(lct_numa_t *numa, const lct_numa_topo_t *topo) {
+  if (!numa)
+    return -1;
+
+  memset(numa, 0, sizeof(lct_numa_t));
+
+  if (topo) {
+    if (!topo->nnodes || !topo->ncpus || !topo->cpu_node)
+      return -1;
+
+    numa->nnodes = topo->nnodes;
+    numa->ncpus = topo->ncpus;
+    if (!(numa->cpu_node = (uint32_t *) malloc(topo->ncpus * sizeof(uint32_t))))
+      return -1;
+
+    for (uint32_t i = 0; i < topo->ncpus; ++i) {
+      if (topo->cpu_node[i] >= topo->nnodes) {
+        fprintf(stderr, "ERROR: cpu %u is on node %u of only %u nodes\n",
+                i, topo->cpu_node[i], topo->nnodes);
+        free(numa->cpu_node);
+        return -1;
+      }
+      numa->cpu_node[i] = topo->cpu_node[i];
+    }
+  }
+  else if (detect_topology(numa)) {
+    fprintf(stderr, "ERROR: failed to allocate NUMA topology\n");
+    return -1;
+  }
+
+  if (!(numa->nodes = (lct_numa_node_t *) calloc(numa->nnodes, sizeof(lct_numa_node_t)))) {
+    fprintf(stderr, "ERROR: failed to allocate NUMA replica set\n");
+    free(numa->cpu_node);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < numa->nnodes; ++i) {
+    numa->nodes[i].node = i;
+    numa->nodes[i].alloc.malloc = numa_malloc;
+    numa->nodes[i].alloc.realloc = numa_realloc;
+    numa->nodes[i].alloc.free = numa_free;
+    numa->nodes[i].alloc.ctx = &numa->nodes[i];
+  }
+
+  return 0;
+}
+
+// the replica carries its own node local allocator, so lct_free()
+// takes care of everything but the outer struct
+static
+void replica_free(lct_t *replica) {
+  if (!replica)
+    return;
+
+  lct_free(replica);
+  free(replica);
+}
+
+void lct_numa_free(lct_numa_t *numa) {
+  if (!numa)
+    return;
+
+  for (uint32_t i = 0; i < numa->nnodes && numa->nodes; ++i) {
+    replica_free(numa->nodes[i].replica);
+    replica_free(numa->nodes[i].retired);
+  }
+
+  free(numa->nodes);
+  free(numa->cpu_node);
+  memset(numa, 0, sizeof(lct_numa_t));
+}
+
+// copy the lookup arrays of a trie into a node's memory
+static
+lct_t *replicate(lct_numa_node_t *n, const lct_t *trie) {
+  lct_t *replica;
+
+  if (!(replica = (lct_t *) malloc(sizeof(lct_t))))
+    return NULL;
+
+  // everything but the cold subnet array is replicated, that stays shared
+  memset(replica, 0, sizeof(lct_t));
+  replica->ncount = trie->ncount;
+  replica->bcount = trie->bcount;
+  replica->scount = trie->scount;
+  replica->shortest = trie->shortest;
+  replica->gen = trie->gen;
+  replica->root_branch = trie->root_branch;
+  replica->fill = trie->fill;
+  replica->exp_depth = trie->exp_depth;
+  replica->prof_depth = trie->prof_depth;
+  replica->nets = trie->nets;
+  replica->alloc = n->alloc;
+  replica->root = lct_mem_alloc(&replica->alloc, trie->ncount * sizeof(lct_node_t));
+  replica->bases = lct_mem_alloc(&replica->alloc, trie->bcount * sizeof(uint32_t));
+  if (trie->hot)
+    replica->hot = lct_mem_alloc(&replica->alloc, trie->scount * sizeof(lct_hot_t));
+  replica->acount = trie->acount;
+  if (trie->attrs)
+    replica->attrs = lct_mem_alloc(&replica->alloc, trie->acount * sizeof(lct_subnet_info_t));
+  if (trie->attr16)
+    replica->attr16 = lct_mem_alloc(&replica->alloc, trie->scount * sizeof(uint16_t));
+  if (trie->attr32)
+    replica->attr32 = lct_mem_alloc(&replica->alloc, trie->scount * sizeof(uint32_t));
+  replica->filter_bits = trie->filter_bits;
+  replica->filter_runs = trie->filter_runs;
+  if (trie->filter) {
+    replica->filter = lct_mem_alloc(&replica->alloc, (1 << trie->filter_bits >> 6) * sizeof(lct_filter_t));
+    replica->filter_ids = lct_mem_alloc(&replica->alloc, trie->filter_runs * sizeof(uint32_t));
+  }
+  if (trie->chain) {
+    replica->chainoff = lct_mem_alloc(&replica->alloc, (trie->scount + 1) * sizeof(uint32_t));
+    replica->chain = lct_mem_alloc(&replica->alloc, (trie->chainoff[trie->scount] + 1) * sizeof(uint32_t));
+  }
+  replica->nasns = trie->nasns;
+  if (trie->asns) {
+    replica->asns = lct_mem_alloc(&replica->alloc, (trie->nasns ? trie->nasns : 1) * sizeof(uint32_t));
+    replica->asn_off = lct_mem_alloc(&replica->alloc, (trie->nasns + 1) * sizeof(uint32_t));
+    replica->asn_nets = lct_mem_alloc(&replica->alloc, (trie->asn_off[trie->nasns] + 1) * sizeof(uint32_t));
+    replica->cidr_off = lct_mem_alloc(&replica->alloc, (trie->nasns + 1) * sizeof(uint32_t));
+    replica->asn_cidrs = lct_mem_alloc(&replica->alloc, (trie->cidr_off[trie->nasns] + 1) * sizeof(lct_cidr_t));
+  }
+
+  if (!replica->root || !replica->bases || (trie->hot && !replica->hot) ||
+      (trie->attrs && !replica->attrs) || (trie->attr16 && !replica->attr16) ||
+      (trie->attr32 && !replica->attr32) ||
+      (trie->filter && (!replica->filter || !replica->filter_ids)) ||
+      (trie->chain && (!replica->chainoff || !replica->chain)) ||
+      (trie->asns && (!replica->asns || !replica->asn_off || !replica->asn_nets ||
+                      !replica->cidr_off || !replica->asn_cidrs))) {
+    replica_free(replica);
+    return NULL;
+  }
+
+  memcpy(replica->root, trie->root, trie->ncount * sizeof(lct_node_t));
+  memcpy(replica->bases, trie->bases, trie->bcount * sizeof(uint32_t));
+  if (trie->hot)
+    memcpy(replica->hot, trie->hot, trie->scount * sizeof(lct_hot_t));
+  if (trie->attrs)
+    memcpy(replica->attrs, trie->attrs, trie->acount * sizeof(lct_subnet_info_t));
+  if (trie->attr16)
+    memcpy(replica->attr16, trie->attr16, trie->scount * sizeof(uint16_t));
+  if (trie->attr32)
+    memcpy(replica->attr32, trie->attr32, trie->scount * sizeof(uint32_t));
+  if (trie->filter) {
+    memcpy(replica->filter, trie->filter, (1 << trie->filter_bits >> 6) * sizeof(lct_filter_t));
+    memcpy(replica->filter_ids, trie->filter_ids, trie->filter_runs * sizeof(uint32_t));
+  }
+  if (trie->chain) {
+    memcpy(replica->chainoff, trie->chainoff, (trie->scount + 1) * sizeof(uint32_t));
+    memcpy(replica->chain, trie->chain, (trie->chainoff[trie->scount] + 1) * sizeof(uint32_t));
+  }
+  if (trie->asns) {
+    memcpy(replica->asns, trie->asns, trie->nasns * sizeof(uint32_t));
+    memcpy(replica->asn_off, trie->asn_off, (trie->nasns + 1) * sizeof(uint32_t));
+    memcpy(replica->asn_nets, trie->asn_nets, trie->asn_off[trie->nasns] * sizeof(uint32_t));
+    memcpy(replica->cidr_off, trie->cidr_off, (trie->nasns + 1) * sizeof(uint32_t));
+    memcpy(replica->asn_cidrs, trie->asn_cidrs, trie->cidr_off[trie->nasns] * sizeof(lct_cidr_t));
+  }
+
+  return replica;
+}
+
+int lct_numa_publish(lct_numa_t *numa, const lct_t *trie) {
+  lct_t **replicas, *old;
+
+  if (!numa || !trie || !trie->root)
+    return -1;
+
+  // make every copy before publishing any of them, so lookup threads
+  // never see a mix of old and new tries across the nodes
+  if (!(replicas = (lct_t **) calloc(numa->nnodes, sizeof(lct_t *))))
+    return -1;
+
+  for (uint32_t i = 0; i < numa->nnodes; ++i) {
+    if (!(replicas[i] = replicate(&numa->nodes[i], trie))) {
+      fprintf(stderr, "ERROR: failed to replicate trie onto NUMA node %u\n", i);
+      for (uint32_t j = 0; j < i; ++j)
+        replica_free(replicas[j]);
+      free(replicas);
+      return -1;
+    }
+  }
+
+  for (uint32_t i = 0; i < numa->nnodes; ++i) {
+    old = __atomic_exchange_n(&numa->nodes[i].replica, replicas[i], __ATOMIC_ACQ_REL);
+
+    // nothing tracks readers, so this relies on the contract in the
+    // header that no lookup holds a handle across two publishes
+    replica_free(numa->nodes[i].retired);
+    numa->nodes[i].retired = old;
+  }
+
+  free(replicas);
+  return 0;
+}
+
+lct_t *lct_numa_replica(lct_numa_t *numa, uint32_t node) {
+  if (!numa || node >= numa->nnodes)
+    return NULL;
+
+  return __atomic_load_n(&numa->nodes[node].replica, __ATOMIC_ACQUIRE);
+}
+
+lct_t *lct_numa_local(lct_numa_t *numa) {
+  int cpu;
+
+  if (!numa)
+    return NULL;
+
+  cpu = sched_getcpu();
+  if (cpu < 0 || cpu >= numa->ncpus)
+    return lct_numa_replica(numa, 0);
+
+  return lct_numa_replica(numa, numa->cpu_node[cpu]);
+}
@@ -0,0 +1,79 @@
+#ifndef __LC_TRIE_NUMA_H__
+#define __LC_TRIE_NUMA_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NUMA aware trie replication
+//
+// Lookup threads on a remote socket pay the interconnect latency for every
+// trie node they touch.  A built trie can be replicated onto each NUMA node
+// so that every lookup thread walks a copy of the nodes, bases, and hot
+// subnet array sitting in its own node's memory, along with the prefix
+// chains, attribute ids, fast miss filter, and ASN index the trie was built
+// with, so every lookup call works on a replica.  The cold subnet array is
+// shared by all of the replicas, so it must outlive them.
+//
+// Publishing a rebuilt trie swaps the new replicas in on every node at once.
+// The replicas being replaced are freed by the following publish, and
+// nothing tracks the readers, so it's up to the caller to make sure no
+// lookup thread ever holds a handle across two publishes.  A lookup thread
+// should fetch its handle again for every batch of work, and publishes have
+// to be spaced further apart than the longest batch, or serialized against
+// the lookup threads by some other means such as a barrier.
+
+// NUMA topology, which node each cpu belongs to.  this may be filled in
+// by hand to fake a multi-node topology on a single node machine.
+typedef struct lct_numa_topo {
+  uint32_t nnodes;            // number of NUMA nodes
+  uint32_t ncpus;             // number of entries in cpu_node
+  const uint32_t *cpu_node;   // NUMA node of each cpu
+} lct_numa_topo_t;
+
+// per node replica state.  the allocator context points back at this.
+typedef struct lct_numa_node {
+  uint32_t node;              // NUMA node id the memory is bound to
+  lct_allocator_t alloc;      // node local allocator for the replicas
+  lct_t *replica;             // currently published replica
+  lct_t *retired;             // previously published replica
+} lct_numa_node_t;
+
+typedef struct lct_numa {
+  uint32_t nnodes;
+  uint32_t ncpus;
+  uint32_t *cpu_node;         // NUMA node of each cpu
+  lct_numa_node_t *nodes;     // replica state of each node
+} lct_numa_t;
+
+// set up the replica set for a topology, or for the detected topology of
+// the machine from sysfs if topo is NULL.  returns 0 on success.
+extern int lct_numa_init(lct_numa_t *numa, const lct_numa_topo_t *topo);
+
+// frees every replica as well as the replica set itself.  no lookups may be
+// in flight on any of the replicas.
+extern void lct_numa_free(lct_numa_t *numa);
+
+// copy a built trie onto every NUMA node and publish the copies.
+// the source trie may be freed afterwards, but not its subnet array.
+extern int lct_numa_publish(lct_numa_t *numa, const lct_t *trie);
+
+// handle to the published replica on the calling cpu's NUMA node,
+// NULL if nothing has been published yet
+extern lct_t *lct_numa_local(lct_numa_t *numa);
+
+// handle to the published replica of a specific NUMA node
+extern lct_t *lct_numa_replica(lct_numa_t *numa, uint32_t node);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
@@ -0,0 +1,180 @@
+#include "lctrie_pipe.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+
+// spins on an empty or full ring before giving up the cpu
+#define PIPE_SPINS        64
+
+int lct_ring_init(lct_ring_t *ring, uint32_t size) {
+  uint32_t slots = 2;
+
+  if (!ring || !size || size > (1U << 31))
+    return -1;
+
+  while (slots < size)
+    slots <<= 1;
+
+  memset(ring, 0, sizeof(lct_ring_t));
+  ring->mask = slots - 1;
+  if (!(ring->slots = (lct_pipe_batch_t **) calloc(slots, sizeof(lct_pipe_batch_t *)))) {
+    fprintf(stderr, "ERROR: failed to allocate ring slots\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+void lct_ring_free(lct_ring_t *ring) {
+  if (!ring)
+    return;
+
+  free(ring->slots);
+  ring->slots = NULL;
+}
+
+// the positions count up forever and wrap around, so head - tail is always
+// the number of batches in the ring
+int lct_ring_push(lct_ring_t *ring, lct_pipe_batch_t *batch) {
+  uint32_t head = ring->head;
+
+  if (head - ring->tail_cache > ring->mask) {
+    ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - ring->tail_cache > ring->mask)
+      return -1;
+  }
+
+  ring->slots[head & ring->mask] = batch;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+lct_pipe_batch_t *lct_ring_pop(lct_ring_t *ring) {
+  uint32_t tail = ring->tail;
+  lct_pipe_batch_t *batch;
+
+  if (tail == ring->head_cache) {
+    ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == ring->head_cache)
+      return NULL;
+  }
+
+  batch = ring->slots[tail & ring->mask];
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return batch;
+}
+
+static
+void *pipe_worker(void *arg) {
+  lct_pipe_worker_t *w = (lct_pipe_worker_t *) arg;
+  lct_pipe_batch_t *batch;
+  int spins = 0;
+
+  while (!__atomic_load_n(&w->pipe->stop, __ATOMIC_ACQUIRE)) {
+    if (!(batch = lct_ring_pop(&w->in))) {
+      ++w->idle;
+      if (++spins >= PIPE_SPINS) {
+        sched_yield();
+        spins = 0;
+      }
+      continue;
+    }
+    spins = 0;
+
+    lct_find_batch_buf(w->pipe->trie, batch->keys, batch->results, batch->n, w->sortbuf);
+    ++w->batches;
+    w->keys += batch->n;
+
+    // back pressure from the collector, wait for it to make room
+    while (lct_ring_push(&w->out, batch)) {
+      ++w->stalls;
+      if (__atomic_load_n(&w->pipe->stop, __ATOMIC_ACQUIRE))
+        return NULL;
+      if (++spins >= PIPE_SPINS) {
+        sched_yield();
+        spins = 0;
+      }
+    }
+    spins = 0;
+  }
+
+  return NULL;
+}
+
+int lct_pipe_start(lct_pipe_t *pipe, lct_t *trie, uint32_t nworkers,
+                   uint32_t ring_size) {
+  void *workers;
+  uint32_t i;
+
+  if (!pipe || !trie || !nworkers)
+    return -1;
+
+  memset(pipe, 0, sizeof(lct_pipe_t));
+  pipe->trie = trie;
+
+  // keep the ring ends on their own cache lines
+  if (posix_memalign(&workers, LCT_CACHE_LINE, nworkers * sizeof(lct_pipe_worker_t))) {
+    fprintf(stderr, "ERROR: failed to allocate pipeline workers\n");
+    return -1;
+  }
+  memset(workers, 0, nworkers * sizeof(lct_pipe_worker_t));
+  pipe->workers = (lct_pipe_worker_t *) workers;
+
+  for (i = 0; i < nworkers; ++i) {
+    lct_pipe_worker_t *w = &pipe->workers[i];
+
+    w->pipe = pipe;
+    if (lct_ring_init(&w->in, ring_size) || lct_ring_init(&w->out, ring_size) ||
+        pthread_create(&w->thread, NULL, pipe_worker, w)) {
+      fprintf(stderr, "ERROR: failed to start pipeline worker %u\n", i);
+      lct_ring_free(&w->in);
+      lct_ring_free(&w->out);
+      break;
+    }
+    ++pipe->nworkers;
+  }
+
+  if (pipe->nworkers < nworkers) {
+    lct_pipe_stop(pipe);
+    return -1;
+  }
+
+  return 0;
+}
+
+void lct_pipe_stop(lct_pipe_t *pipe) {
+  if (!pipe || !pipe->workers)
+    return;
+
+  __atomic_store_n(&pipe->stop, 1, __ATOMIC_RELEASE);
+  for (uint32_t i = 0; i < pipe->nworkers; ++i) {
+    pthread_join(pipe->workers[i].thread, NULL);
+    lct_ring_free(&pipe->workers[i].in);
+    lct_ring_free(&pipe->workers[i].out);
+  }
+
+  free(pipe->workers);
+  pipe->workers = NULL;
+  pipe->nworkers = 0;
+}
+
+int lct_pipe_submit(lct_pipe_t *pipe, uint32_t worker, lct_pipe_batch_t *batch) {
+  // the results array only has room for LCT_PIPE_BATCH subnets
+  if (!pipe || worker >= pipe->nworkers || !batch || batch->n > LCT_PIPE_BATCH)
+    return -1;
+
+  if (lct_ring_push(&pipe->workers[worker].in, batch)) {
+    ++pipe->workers[worker].rejects;
+    return -1;
+  }
+
+  return 0;
+}
+
+lct_pipe_batch_t *lct_pipe_collect(lct_pipe_t *pipe, uint32_t worker) {
+  if (!pipe || worker >= pipe->nworkers)
+    return NULL;
+
+  return lct_ring_pop(&pipe->workers[worker].out);
+}
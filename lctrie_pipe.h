@@ -0,0 +1,113 @@
+#ifndef __LC_TRIE_PIPE_H__
+#define __LC_TRIE_PIPE_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Classification pipeline
+//
+// Capture threads produce addresses faster than one thread can look them
+// up, so the pipeline fans batches of keys out to classifier worker threads
+// and hands the finished batches back.  Every worker has an input ring and
+// an output ring, each a lock free single producer, single consumer queue of
+// batch pointers.  Exactly one thread may submit to a given worker, and
+// exactly one thread may collect from it, though that can be the same
+// thread.  A full input ring pushes back on the producer instead of
+// blocking, so it can decide whether to wait, drop, or try another worker.
+
+#define LCT_PIPE_BATCH      256   // keys per batch
+#define LCT_CACHE_LINE      64
+
+// a batch of keys and their results, owned by the caller
+typedef struct lct_pipe_batch {
+  uint32_t n;                             // number of keys in the batch
+  uint32_t keys[LCT_PIPE_BATCH];          // host byte ordered keys
+  lct_subnet_t *results[LCT_PIPE_BATCH];  // matching subnets or NULL
+  void *user;                             // caller's data, left untouched
+} lct_pipe_batch_t;
+
+// single producer single consumer ring.  the producer and consumer ends
+// each get their own cache line, along with a cached copy of the other
+// end's position so they only have to look at each other's line when the
+// ring looks full or empty.
+typedef struct lct_ring {
+  uint32_t mask;                  // number of slots - 1
+  lct_pipe_batch_t **slots;
+
+  uint32_t head __attribute__((aligned(LCT_CACHE_LINE)));  // next to push
+  uint32_t tail_cache;            // producer's last look at the tail
+
+  uint32_t tail __attribute__((aligned(LCT_CACHE_LINE)));  // next to pop
+  uint32_t head_cache;            // consumer's last look at the head
+} lct_ring_t;
+
+// set up a ring of at least size slots, rounded up to a power of two
+extern int lct_ring_init(lct_ring_t *ring, uint32_t size);
+extern void lct_ring_free(lct_ring_t *ring);
+
+// push a batch, returns 0 on success or -1 if the ring is full
+extern int lct_ring_push(lct_ring_t *ring, lct_pipe_batch_t *batch);
+
+// pop a batch, returns NULL if the ring is empty
+extern lct_pipe_batch_t *lct_ring_pop(lct_ring_t *ring);
+
+struct lct_pipe;
+
+typedef struct lct_pipe_worker {
+  lct_ring_t in;                  // batches waiting for classification
+  lct_ring_t out;                 // classified batches waiting to be collected
+  struct lct_pipe *pipe;
+  pthread_t thread;
+
+  // sort buffer for the batch lookup, so it never has to allocate one
+  uint32_t sortbuf[LCT_BATCH_BUF_BYTES(LCT_PIPE_BATCH) / sizeof(uint32_t)];
+
+  // throughput counters, only written by the worker thread
+  uint64_t batches;               // batches classified
+  uint64_t keys;                  // keys classified
+  uint64_t idle;                  // polls finding the input ring empty
+  uint64_t stalls;                // pushes finding the output ring full
+
+  // only written by the producer
+  uint64_t rejects __attribute__((aligned(LCT_CACHE_LINE)));  // submits
+                                  // turned away by a full input ring
+} lct_pipe_worker_t;
+
+typedef struct lct_pipe {
+  lct_t *trie;
+  uint32_t nworkers;
+  lct_pipe_worker_t *workers;
+  int stop;                       // tells the workers to exit
+} lct_pipe_t;
+
+// start nworkers classifier threads looking up keys in the trie, each with
+// input and output rings of ring_size batches.  returns 0 on success.
+extern int lct_pipe_start(lct_pipe_t *pipe, lct_t *trie, uint32_t nworkers,
+                          uint32_t ring_size);
+
+// stop and join the workers, then free the rings.  batches still queued
+// are left unclassified, so collect everything before stopping.
+extern void lct_pipe_stop(lct_pipe_t *pipe);
+
+// hand a batch to a worker, returns 0 on success or -1 if its input ring
+// is full or the batch holds more than LCT_PIPE_BATCH keys
+extern int lct_pipe_submit(lct_pipe_t *pipe, uint32_t worker, lct_pipe_batch_t *batch);
+
+// take back a classified batch from a worker, NULL if none are ready
+extern lct_pipe_batch_t *lct_pipe_collect(lct_pipe_t *pipe, uint32_t worker);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
@@ -0,0 +1,182 @@
+#include "lctrie_stats.h"
+
+#include <string.h>
+
+// traversal state shared across the recursion
+typedef struct stats_walk {
+  const lct_t *trie;
+  lct_stats_t *stats;
+  uint8_t *seen;          // bases already pointed at by a leaf
+} stats_walk_t;
+
+// number of non-full prefixes a lookup missing the base may check
+static
+uint32_t chain_len(const lct_t *trie, uint32_t base) {
+  uint32_t len = 0;
+
+  for (uint32_t prep = trie->nets[base].prefix; prep != IP_PREFIX_NIL;
+       prep = trie->nets[prep].prefix)
+    ++len;
+
+  return len;
+}
+
+// path and mask hold the key bits the lookup has actually extracted to get
+// to this node.  share is the fraction of the address space routed here.
+static
+void walk(stats_walk_t *w, uint32_t n, uint32_t depth, uint32_t pos,
+          uint32_t path, uint32_t mask, double share) {
+  const lct_node_t *node = &w->trie->root[n];
+  lct_stats_t *stats = w->stats;
+  const lct_subnet_t *net;
+  uint32_t bits, netmask, base, len;
+
+  if (node->branch == 0) {
+    ++stats->leaves;
+    ++stats->depth_hist[depth];
+    if (depth > stats->depth)
+      stats->depth = depth;
+
+    if (w->seen[node->index])
+      ++stats->duplicate;
+    w->seen[node->index] = 1;
+
+    // leaves of empty slots borrow a neighboring base for its prefixes,
+    // but the base itself can never match anything routed to them
+    base = w->trie->bases[node->index];
+    net = &w->trie->nets[base];
+    netmask = (net->len == 0) ? 0 : ~(UINT32_MAX >> net->len);
+    if ((net->addr ^ path) & mask & netmask) {
+      ++stats->empty;
+      if (depth == 1)
+        ++stats->root_empty;
+    }
+
+    len = chain_len(w->trie, base);
+    stats->exp_depth += share * depth;
+    stats->exp_chain += share * len;
+    return;
+  }
+
+  ++stats->internal;
+  ++stats->branch_hist[depth][node->branch];
+  ++stats->skip_hist[depth][node->skip];
+  if (depth == 0)
+    stats->root_slots = 1 << node->branch;
+
+  // skipped bits are never compared, so they don't count as known
+  pos += node->skip;
+  for (uint32_t i = 0; i < (1 << node->branch); ++i) {
+    bits = 32 - pos - node->branch;
+    walk(w, node->index + i, depth + 1, pos + node->branch,
+         path | (i << bits),
+         mask | (((1 << node->branch) - 1) << bits),
+         share / (1 << node->branch));
+  }
+}
+
+int lct_stats(const lct_t *trie, lct_stats_t *stats) {
+  stats_walk_t w;
+  uint32_t distinct;
+
+  if (!trie || !trie->root || !stats)
+    return -1;
+
+  memset(stats, 0, sizeof(lct_stats_t));
+  stats->nodes = trie->ncount;
+  stats->bases = trie->bcount;
+  stats->subnets = trie->scount;
+
+  stats->bytes = trie->ncount * sizeof(lct_node_t) + trie->bcount * sizeof(uint32_t);
+  if (trie->hot)
+    stats->bytes += trie->scount * sizeof(lct_hot_t);
+  if (trie->chain)
+    stats->bytes += (trie->scount + 1 + trie->chainoff[trie->scount]) * sizeof(uint32_t);
+  if (trie->attrs)
+    stats->bytes += trie->acount * sizeof(lct_subnet_info_t) +
+                    trie->scount * (trie->attr16 ? sizeof(uint16_t) : sizeof(uint32_t));
+  if (trie->filter)
+    stats->bytes += (1 << trie->filter_bits >> 6) * sizeof(lct_filter_t) +
+                    trie->filter_runs * sizeof(uint32_t);
+  if (trie->asns)
+    stats->bytes += (3 * trie->nasns + 2) * sizeof(uint32_t) +
+                    trie->asn_off[trie->nasns] * sizeof(uint32_t) +
+                    trie->cidr_off[trie->nasns] * sizeof(lct_cidr_t);
+
+  for (uint32_t i = 0; i < trie->bcount; ++i) {
+    uint32_t len = chain_len(trie, trie->bases[i]);
+    ++stats->chain_hist[(len < LCT_STATS_BITS) ? len : LCT_STATS_BITS - 1];
+  }
+
+  w.trie = trie;
+  w.stats = stats;
+  if (!(w.seen = (uint8_t *) calloc(trie->bcount, sizeof(uint8_t))))
+    return -1;
+
+  walk(&w, 0, 0, 0, 0, 0, 1.0);
+  free(w.seen);
+
+  distinct = stats->leaves - stats->duplicate;
+  stats->leaf_fill = stats->leaves ? (double) distinct / stats->leaves : 0.0;
+
+  return 0;
+}
+
+// print a histogram as a JSON array, trimming off the trailing zeroes
+static
+void json_hist(const uint32_t *hist, uint32_t num, FILE *out) {
+  while (num > 1 && hist[num - 1] == 0)
+    --num;
+
+  fprintf(out, "[");
+  for (uint32_t i = 0; i < num; ++i)
+    fprintf(out, "%s%u", i ? "," : "", hist[i]);
+  fprintf(out, "]");
+}
+
+void lct_stats_json(const lct_stats_t *stats, FILE *out) {
+  if (!stats || !out)
+    return;
+
+  fprintf(out, "{\n");
+  fprintf(out, "  \"nodes\": %u,\n", stats->nodes);
+  fprintf(out, "  \"internal\": %u,\n", stats->internal);
+  fprintf(out, "  \"leaves\": %u,\n", stats->leaves);
+  fprintf(out, "  \"bases\": %u,\n", stats->bases);
+  fprintf(out, "  \"subnets\": %u,\n", stats->subnets);
+  fprintf(out, "  \"depth\": %u,\n", stats->depth);
+  fprintf(out, "  \"bytes\": %lu,\n", (unsigned long) stats->bytes);
+  fprintf(out, "  \"root_slots\": %u,\n", stats->root_slots);
+  fprintf(out, "  \"root_empty\": %u,\n", stats->root_empty);
+  fprintf(out, "  \"empty\": %u,\n", stats->empty);
+  fprintf(out, "  \"duplicate\": %u,\n", stats->duplicate);
+  fprintf(out, "  \"leaf_fill\": %.6f,\n", stats->leaf_fill);
+  fprintf(out, "  \"exp_depth\": %.6f,\n", stats->exp_depth);
+  fprintf(out, "  \"exp_chain\": %.6f,\n", stats->exp_chain);
+
+  fprintf(out, "  \"depth_hist\": ");
+  json_hist(stats->depth_hist, stats->depth + 1, out);
+  fprintf(out, ",\n");
+
+  fprintf(out, "  \"chain_hist\": ");
+  json_hist(stats->chain_hist, LCT_STATS_BITS, out);
+  fprintf(out, ",\n");
+
+  // no internal nodes live on the deepest level
+  fprintf(out, "  \"branch_hist\": [\n");
+  for (uint32_t d = 0; d < stats->depth; ++d) {
+    fprintf(out, "    ");
+    json_hist(stats->branch_hist[d], LCT_STATS_BITS, out);
+    fprintf(out, "%s\n", (d + 1 < stats->depth) ? "," : "");
+  }
+  fprintf(out, "  ],\n");
+
+  fprintf(out, "  \"skip_hist\": [\n");
+  for (uint32_t d = 0; d < stats->depth; ++d) {
+    fprintf(out, "    ");
+    json_hist(stats->skip_hist[d], LCT_STATS_BITS, out);
+    fprintf(out, "%s\n", (d + 1 < stats->depth) ? "," : "");
+  }
+  fprintf(out, "  ]\n");
+  fprintf(out, "}\n");
+}
@@ -0,0 +1,66 @@
+#ifndef __LC_TRIE_STATS_H__
+#define __LC_TRIE_STATS_H__
+// begin #ifndef guard
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lctrie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Trie structure introspection
+//
+// Everything needed to tune the shape of a trie, gathered in one traversal.
+// Depths count the nodes visited below the root, so a leaf hanging directly
+// off of the root is at depth 1.  Histograms by level are indexed by the
+// depth of the node and then by its branch or skip bits.
+
+#define LCT_STATS_LEVELS  33  // deepest possible trie, one bit per level
+#define LCT_STATS_BITS    33  // 0 through 32 bits
+
+typedef struct lct_stats {
+  uint32_t nodes;         // total trie nodes
+  uint32_t internal;      // nodes with children
+  uint32_t leaves;        // nodes pointing at a base subnet
+  uint32_t bases;         // base subnets
+  uint32_t subnets;       // subnets in the subnet array
+  uint32_t depth;         // depth of the deepest leaf
+  uint64_t bytes;         // memory used by the trie, not counting the subnets
+
+  uint32_t depth_hist[LCT_STATS_LEVELS];                  // leaves by depth
+  uint32_t branch_hist[LCT_STATS_LEVELS][LCT_STATS_BITS]; // internal nodes by
+                                                          // depth and branch
+  uint32_t skip_hist[LCT_STATS_LEVELS][LCT_STATS_BITS];   // internal nodes by
+                                                          // depth and skip
+
+  uint32_t root_slots;    // children of the root node
+  uint32_t root_empty;    // root children filling in for an empty slot
+  uint32_t empty;         // leaves filling in for an empty slot with a
+                          // neighboring base that doesn't cover the slot
+  uint32_t duplicate;     // leaves repeating a base another leaf points at
+  double leaf_fill;       // distinct bases per leaf
+
+  uint32_t chain_hist[LCT_STATS_BITS];  // bases by the number of prefixes
+                                        // a missed lookup may have to check
+
+  double exp_depth;       // expected lookup depth over the whole address space
+  double exp_chain;       // expected length of the prefix chain behind the
+                          // leaf over the whole address space
+} lct_stats_t;
+
+// compute the statistics of a built trie, returns 0 on success
+extern int lct_stats(const lct_t *trie, lct_stats_t *stats);
+
+// dump the statistics as a JSON object
+extern void lct_stats_json(const lct_stats_t *stats, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+// end #ifndef guard
+#endif
@@ -5,6 +5,9 @@
 #include <errno.h>
 #include <time.h>
 #include <locale.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include <arpa/inet.h>
 #include <sys/time.h>
@@ -12,6 +15,12 @@
 #include "lctrie_ip.h"
 #include "lctrie_bgp.h"
 #include "lctrie.h"
+#include "lctrie_numa.h"
+#include "lctrie_acct.h"
+#include "lctrie_stats.h"
+#include "lctrie_cache.h"
+#include "lctrie_pipe.h"
+#include "lctrie_multi.h"
 
 #define BGP_MAX_ENTRIES             4000000
 #define BGP_READ_FILE               1
@@ -21,6 +30,7 @@
 #define LCT_INIT_SPECIAL            1
 
 #define LCT_VERIFY_PREFIXES         1
+#define LCT_MULTI_TENANTS           16
 #define LCT_IP_DISPLAY_PREFIXES     0
 
 static unsigned long next = 1;
@@ -146,6 +156,668 @@ void print_subnet_stats(lct_subnet_t *subnet, lct_ip_stats_t *stats) {
   }
 }
 
+// time 50 million pseudo-random lookups.  the generator is reseeded
+// on every call so each run looks up the exact same keys.  with an
+// accounting context every lookup is tallied as a randomly sized packet.
+void perf_test(lct_t *t, lct_acct_t *acct, const char *desc) {
+  unsigned int nlookup = 0, nhit = 0, nmiss = 0;
+  lct_subnet_t *subnet;
+  uint32_t prefix;
+
+  next = 1;
+
+  // start the stop clock
+  struct timeval start, now;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 50000000; i++) {
+
+    // just grab a random number and check to match
+    prefix = fastrand();
+
+    // record the lookup, hit, and miss stats
+    ++nlookup;
+    if (acct)
+      subnet = lct_find_acct(t, acct, 0, prefix, 64 + prefix % 1437);
+    else
+      subnet = lct_find(t, prefix);
+    if (subnet) {
+      ++nhit;
+    }
+    else {
+      ++nmiss;
+    }
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+  // timer has millisecond accuracy
+
+  printf("Complete on %s.\n", desc);
+  printf("%'u lookups with %'u hits and %'u misses in %ldms.\n", nlookup, nhit, nmiss,
+         took_ms);
+  printf("%'lu lookups/sec.\n\n", nlookup / took_ms * 1000);
+}
+
+// start the skewed flow traffic over from the beginning
+static
+void skewed_start(uint32_t *flows) {
+  next = 1;
+  for (int i = 0; i < 4096; ++i)
+    flows[i] = fastrand() ^ (fastrand() << 16);
+}
+
+// the next address of the skewed flow traffic
+static
+uint32_t skewed_key(const uint32_t *flows) {
+  uint32_t r = fastrand();
+
+  if (r % 10) {
+    // cubing a uniform pick skews it towards the front of the pool
+    uint64_t u = r % 4096;
+    return flows[(u * u * u) >> 24];
+  }
+  return fastrand() ^ (fastrand() << 16);
+}
+
+// time 50 million lookups of skewed traffic, where 90% of the lookups go to
+// a pool of 4096 flows with a few of them far busier than the rest.  with a
+// flow cache the lookups go through it instead of straight to the trie.
+void perf_test_skewed(lct_t *t, lct_cache_t *cache, const char *desc) {
+  unsigned int nlookup = 0, nhit = 0, nmiss = 0;
+  lct_subnet_t *subnet;
+  uint32_t prefix, flows[4096];
+
+  skewed_start(flows);
+
+  struct timeval start, now;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 50000000; i++) {
+    prefix = skewed_key(flows);
+
+    ++nlookup;
+    subnet = cache ? lct_cache_find(cache, t, prefix) : lct_find(t, prefix);
+    if (subnet) {
+      ++nhit;
+    }
+    else {
+      ++nmiss;
+    }
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+
+  printf("Complete on %s.\n", desc);
+  printf("%'u lookups with %'u hits and %'u misses in %ldms.\n", nlookup, nhit, nmiss,
+         took_ms);
+  if (cache)
+    printf("Flow cache hit rate %1.2f%%.\n",
+           (100.0 * cache->hits) / (cache->hits + cache->misses));
+  printf("%'lu lookups/sec.\n\n", nlookup / took_ms * 1000);
+}
+
+// time a sequential sweep over 50 million addresses from 1.0.0.0 up, like a
+// scanner or a sorted log would produce.  with ranges, every address inside
+// the range of the last answer reuses it instead of being looked up.
+void perf_test_sweep(lct_t *t, int ranges, const char *desc) {
+  unsigned int nlookup = 0, nhit = 0, nmiss = 0;
+  uint32_t key, lo = 1, hi = 0;
+  lct_subnet_t *subnet = NULL;
+
+  struct timeval start, now;
+  gettimeofday(&start, NULL);
+  for (key = 0x01000000; key < 0x01000000 + 50000000; ++key) {
+    if (!ranges) {
+      ++nlookup;
+      subnet = lct_find(t, key);
+    }
+    else if (key < lo || key > hi) {
+      ++nlookup;
+      subnet = lct_find_range(t, key, &lo, &hi);
+    }
+
+    if (subnet) {
+      ++nhit;
+    }
+    else {
+      ++nmiss;
+    }
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+  if (!took_ms)
+    took_ms = 1;
+
+  printf("Complete on %s.\n", desc);
+  printf("%'u addresses with %'u hits and %'u misses in %ldms, using %'u lookups.\n",
+         nhit + nmiss, nhit, nmiss, took_ms, nlookup);
+  printf("%'lu addresses/sec.\n\n", (unsigned long) (nhit + nmiss) * 1000 / took_ms);
+}
+
+// time 50 million pseudo-random lookups in batches of a million keys,
+// either with the batch lookup or with a lookup for every key
+void perf_test_batch(lct_t *t, int batch, const char *desc) {
+  unsigned int nlookup = 0, nhit = 0, nmiss = 0;
+  uint32_t *keys, n = 1000000;
+  lct_subnet_t **results;
+  unsigned long took_ms = 0;
+
+  keys = (uint32_t *) malloc(n * sizeof(uint32_t));
+  results = (lct_subnet_t **) malloc(n * sizeof(lct_subnet_t *));
+  if (!keys || !results) {
+    fprintf(stderr, "Could not allocate batch buffers\n");
+    free(keys);
+    free(results);
+    return;
+  }
+
+  next = 1;
+  for (int j = 0; j < 50; j++) {
+    for (uint32_t i = 0; i < n; i++)
+      keys[i] = fastrand();
+
+    // only time the lookups themselves
+    struct timeval start, now;
+    gettimeofday(&start, NULL);
+    if (batch) {
+      lct_find_batch(t, keys, results, n);
+    }
+    else {
+      for (uint32_t i = 0; i < n; i++)
+        results[i] = lct_find(t, keys[i]);
+    }
+    gettimeofday(&now, NULL);
+    took_ms += 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+
+    for (uint32_t i = 0; i < n; i++) {
+      ++nlookup;
+      if (results[i]) {
+        ++nhit;
+      }
+      else {
+        ++nmiss;
+      }
+    }
+  }
+
+  printf("Complete on %s.\n", desc);
+  printf("%'u lookups with %'u hits and %'u misses in %ldms.\n", nlookup, nhit, nmiss,
+         took_ms);
+  printf("%'lu lookups/sec.\n\n", nlookup / took_ms * 1000);
+
+  free(keys);
+  free(results);
+}
+
+// the kind of queue every capture application ends up writing first,
+// one mutex and condition variable protected queue into the classifier
+// threads and another back out.  used as the baseline for the pipeline.
+typedef struct locked_queue {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  lct_pipe_batch_t **slots;
+  uint32_t size, head, tail;
+  int stop;
+} locked_queue_t;
+
+typedef struct locked_pipe {
+  lct_t *trie;
+  locked_queue_t in, out;
+} locked_pipe_t;
+
+static void locked_push(locked_queue_t *q, lct_pipe_batch_t *batch) {
+  pthread_mutex_lock(&q->lock);
+  q->slots[q->head++ % q->size] = batch;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static lct_pipe_batch_t *locked_pop(locked_queue_t *q, int wait) {
+  lct_pipe_batch_t *batch = NULL;
+
+  pthread_mutex_lock(&q->lock);
+  while (wait && q->head == q->tail && !q->stop)
+    pthread_cond_wait(&q->cond, &q->lock);
+  if (q->head != q->tail)
+    batch = q->slots[q->tail++ % q->size];
+  pthread_mutex_unlock(&q->lock);
+
+  return batch;
+}
+
+static void *locked_worker(void *arg) {
+  locked_pipe_t *lp = (locked_pipe_t *) arg;
+  lct_pipe_batch_t *batch;
+
+  while ((batch = locked_pop(&lp->in, 1))) {
+    for (uint32_t i = 0; i < batch->n; ++i)
+      batch->results[i] = lct_find(lp->trie, batch->keys[i]);
+    locked_push(&lp->out, batch);
+  }
+
+  return NULL;
+}
+
+// push 50 million pseudo-random keys through nworkers classifier threads in
+// batches, either over the lock free pipeline or over the locked queues.
+// the calling thread is both the capture thread filling batches and the
+// consumer tallying the results.
+void perf_test_pipe(lct_t *t, uint32_t nworkers, int locked, const char *desc) {
+  unsigned int nlookup = 0, nhit = 0, nmiss = 0;
+  uint32_t nbatches = 50000000 / LCT_PIPE_BATCH, npool = 64 * nworkers;
+  uint32_t submitted = 0, collected = 0, nfree = 0, w = 0, idle = 0;
+  lct_pipe_batch_t *pool, **freelist, *batch;
+  pthread_t *threads = NULL;
+  locked_pipe_t lp;
+  lct_pipe_t pipe;
+
+  pool = (lct_pipe_batch_t *) malloc(npool * sizeof(lct_pipe_batch_t));
+  freelist = (lct_pipe_batch_t **) malloc(npool * sizeof(lct_pipe_batch_t *));
+  if (!pool || !freelist) {
+    fprintf(stderr, "Could not allocate pipeline batches\n");
+    free(pool);
+    free(freelist);
+    return;
+  }
+  for (uint32_t i = 0; i < npool; ++i)
+    freelist[nfree++] = &pool[i];
+
+  next = 1;
+  struct timeval start, now;
+  gettimeofday(&start, NULL);
+
+  if (locked) {
+    memset(&lp, 0, sizeof(locked_pipe_t));
+    lp.trie = t;
+    lp.in.size = lp.out.size = npool;
+    lp.in.slots = (lct_pipe_batch_t **) malloc(npool * sizeof(lct_pipe_batch_t *));
+    lp.out.slots = (lct_pipe_batch_t **) malloc(npool * sizeof(lct_pipe_batch_t *));
+    threads = (pthread_t *) malloc(nworkers * sizeof(pthread_t));
+    pthread_mutex_init(&lp.in.lock, NULL);
+    pthread_mutex_init(&lp.out.lock, NULL);
+    pthread_cond_init(&lp.in.cond, NULL);
+    pthread_cond_init(&lp.out.cond, NULL);
+    for (uint32_t i = 0; i < nworkers; ++i)
+      pthread_create(&threads[i], NULL, locked_worker, &lp);
+  }
+  else if (lct_pipe_start(&pipe, t, nworkers, 64)) {
+    free(pool);
+    free(freelist);
+    return;
+  }
+
+  while (collected < nbatches) {
+    // keep every worker fed while there are batches left to send
+    if (submitted < nbatches && nfree) {
+      batch = freelist[--nfree];
+      batch->n = LCT_PIPE_BATCH;
+      for (uint32_t i = 0; i < LCT_PIPE_BATCH; ++i)
+        batch->keys[i] = fastrand();
+
+      if (locked) {
+        locked_push(&lp.in, batch);
+        ++submitted;
+      }
+      else if (!lct_pipe_submit(&pipe, w, batch)) {
+        ++submitted;
+      }
+      else {
+        freelist[nfree++] = batch;
+      }
+    }
+
+    batch = locked ? locked_pop(&lp.out, nfree == 0) : lct_pipe_collect(&pipe, w);
+    if (batch) {
+      for (uint32_t i = 0; i < batch->n; ++i) {
+        ++nlookup;
+        if (batch->results[i]) {
+          ++nhit;
+        }
+        else {
+          ++nmiss;
+        }
+      }
+      freelist[nfree++] = batch;
+      ++collected;
+      idle = 0;
+    }
+    else if (++idle >= 64) {
+      // nothing back for a while, let the workers have the cpu
+      sched_yield();
+      idle = 0;
+    }
+
+    w = (w + 1) % nworkers;
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+
+  printf("Complete on %s with %u workers.\n", desc, nworkers);
+  printf("%'u lookups with %'u hits and %'u misses in %ldms.\n", nlookup, nhit, nmiss,
+         took_ms);
+  printf("%'lu lookups/sec.\n", nlookup / took_ms * 1000);
+
+  if (locked) {
+    pthread_mutex_lock(&lp.in.lock);
+    lp.in.stop = 1;
+    pthread_cond_broadcast(&lp.in.cond);
+    pthread_mutex_unlock(&lp.in.lock);
+    for (uint32_t i = 0; i < nworkers; ++i)
+      pthread_join(threads[i], NULL);
+    free(lp.in.slots);
+    free(lp.out.slots);
+    free(threads);
+  }
+  else {
+    for (uint32_t i = 0; i < nworkers; ++i)
+      printf("Worker %u classified %'lu batches, %'lu idle polls, %'lu stalls, %'lu rejects.\n",
+             i, pipe.workers[i].batches, pipe.workers[i].idle, pipe.workers[i].stalls,
+             pipe.workers[i].rejects);
+    lct_pipe_stop(&pipe);
+  }
+  printf("\n");
+
+  free(pool);
+  free(freelist);
+}
+
+// aggregate a copy of the table down to what firewalling by type or flow
+// attribution by ASN needs, and time lookups in the much smaller tries
+void aggregate_test(lct_subnet_t *p, int num) {
+  const char *names[] = { "type", "ASN" };
+  int projs[] = { IP_PROJ_TYPE, IP_PROJ_ASN };
+  lct_subnet_t *ap;
+  char desc[64];
+  lct_t at;
+  int anum;
+
+  if (!(ap = (lct_subnet_t *) malloc(num * sizeof(lct_subnet_t))))
+    return;
+
+  for (int i = 0; i < 2; ++i) {
+    memcpy(ap, p, num * sizeof(lct_subnet_t));
+
+    struct timeval start, now;
+    gettimeofday(&start, NULL);
+    anum = subnet_aggregate(ap, num, projs[i]);
+    gettimeofday(&now, NULL);
+    unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+
+    // small enough aggregates get a trie sized to stay in the L2 cache
+    lct_opts_t opts = { .budget = (anum > 0 && anum < 65536) ? 256 * 1024 : 0 };
+    memset(&at, 0, sizeof(lct_t));
+    if (anum <= 0 || lct_build_opts(&at, ap, anum, &opts))
+      continue;
+
+    unsigned long abytes = at.ncount * sizeof(lct_node_t) + at.bcount * sizeof(uint32_t);
+    printf("Aggregating by %s took %ldms leaving %'d of %'d subnets in a %'lu kB trie.\n",
+           names[i], took_ms, anum, num, abytes / 1024);
+    snprintf(desc, sizeof(desc), "subnets aggregated by %s", names[i]);
+    perf_test(&at, NULL, desc);
+    lct_free(&at);
+  }
+
+  free(ap);
+}
+
+// tally 50 million lookups up by the attribute of the subnet they match,
+// first reading the info out of the subnet array and then straight through
+// the attribute ids into an array of counters
+void perf_test_attrs(lct_subnet_t *p, int num) {
+  lct_opts_t opts = { .attrs = 1 };
+  lct_subnet_t *subnet;
+  uint64_t *hits, asnsum = 0;
+  uint32_t id, top[5];
+  int ntop = 0;
+  lct_t t;
+
+  memset(&t, 0, sizeof(lct_t));
+  if (lct_build_opts(&t, p, num, &opts))
+    return;
+  if (!(hits = (uint64_t *) calloc(t.acount, sizeof(uint64_t)))) {
+    lct_free(&t);
+    return;
+  }
+
+  unsigned long attr_bytes = t.acount * sizeof(lct_subnet_info_t) +
+                             t.scount * (t.attr16 ? sizeof(uint16_t) : sizeof(uint32_t));
+  printf("%'u subnets share %'u distinct attributes, taking %'lu kB with %d bit ids.\n",
+         t.scount, t.acount, attr_bytes / 1024, t.attr16 ? 16 : 32);
+
+  struct timeval start, now;
+  next = 1;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 50000000; i++) {
+    if ((subnet = lct_find(&t, fastrand())) && subnet->info.type == IP_SUBNET_BGP)
+      asnsum += subnet->info.bgp.asn;
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+  printf("Complete on reading the attributes out of the subnets.\n");
+  printf("%'u lookups in %ldms, %'lu lookups/sec.\n\n", 50000000, took_ms, 50000000 / took_ms * 1000);
+
+  next = 1;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 50000000; i++) {
+    if (LCT_ATTR_NIL != (id = lct_find_id(&t, fastrand())))
+      ++hits[id];
+  }
+  gettimeofday(&now, NULL);
+  took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+  printf("Complete on tallying the attribute ids.\n");
+  printf("%'u lookups in %ldms, %'lu lookups/sec.\n", 50000000, took_ms, 50000000 / took_ms * 1000);
+
+  // the busiest few, with the ASN sum just keeping the first loop honest
+  for (id = 0; id < t.acount; ++id) {
+    int j = (ntop < 5) ? ntop++ : 5;
+    for (; j > 0 && hits[id] > hits[top[j - 1]]; --j)
+      if (j < 5)
+        top[j] = top[j - 1];
+    if (j < 5)
+      top[j] = id;
+  }
+  printf("Busiest attributes (ASN checksum %lu):\n", (unsigned long) asnsum);
+  for (int j = 0; j < ntop; ++j) {
+    if (t.attrs[top[j]].type == IP_SUBNET_BGP)
+      printf("  ASN %u with %'lu hits\n", t.attrs[top[j]].bgp.asn, (unsigned long) hits[top[j]]);
+    else
+      printf("  type %u with %'lu hits\n", t.attrs[top[j]].type, (unsigned long) hits[top[j]]);
+  }
+  printf("\n");
+
+  free(hits);
+  lct_free(&t);
+}
+
+// reverse queries for the prefixes announced by an ASN, first through the
+// ASN inverted index and then by scanning the whole subnet array
+void asn_test(lct_subnet_t *p, int num) {
+  lct_opts_t opts = { .asn_index = 1 };
+  const lct_cidr_t *cidrs;
+  const uint32_t *idx;
+  uint32_t big = 0, n, nc, asn;
+  uint64_t nsum = 0, csum = 0, lsum = 0;
+  char pstr[INET_ADDRSTRLEN];
+  lct_t t;
+
+  memset(&t, 0, sizeof(lct_t));
+  if (lct_build_opts(&t, p, num, &opts))
+    return;
+  if (!t.nasns) {
+    lct_free(&t);
+    return;
+  }
+
+  // the ASN announcing the most subnets
+  for (uint32_t a = 1; a < t.nasns; ++a)
+    if (t.asn_off[a + 1] - t.asn_off[a] > t.asn_off[big + 1] - t.asn_off[big])
+      big = a;
+
+  unsigned long asn_bytes = t.nasns * 3 * sizeof(uint32_t) + t.asn_off[t.nasns] * sizeof(uint32_t) +
+                            t.cidr_off[t.nasns] * sizeof(lct_cidr_t);
+  printf("%'u ASNs announce %'u subnets, folding down to %'u CIDR blocks in %'lu kB.\n",
+         t.nasns, t.asn_off[t.nasns], t.cidr_off[t.nasns], asn_bytes / 1024);
+  n = lct_asn_subnets(&t, t.asns[big], &idx);
+  nc = lct_asn_cidrs(&t, t.asns[big], &cidrs);
+  printf("ASN %u announces the most with %'u subnets, covered by %'u blocks, the first few being:\n",
+         t.asns[big], n, nc);
+  for (uint32_t i = 0; i < nc && i < 5; ++i) {
+    uint32_t addr = htonl(cidrs[i].addr);
+    inet_ntop(AF_INET, &addr, pstr, sizeof(pstr));
+    printf("  %s/%u\n", pstr, cidrs[i].len);
+  }
+
+  struct timeval start, now;
+  next = 1;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 1000000; i++) {
+    asn = t.asns[fastrand() % t.nasns];
+    nsum += lct_asn_subnets(&t, asn, &idx);
+    csum += lct_asn_cidrs(&t, asn, &cidrs);
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_us = 1000000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec);
+  printf("Complete on indexed reverse queries, %'lu subnets in %'lu blocks.\n",
+         (unsigned long) nsum, (unsigned long) csum);
+  printf("%'u queries in %ldus, %'lu queries/sec.\n", 1000000, took_us,
+         took_us ? 1000000UL * 1000000 / took_us : 0);
+
+  next = 1;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 1000; i++) {
+    asn = t.asns[fastrand() % t.nasns];
+    for (uint32_t j = 0; j < t.scount; ++j)
+      if (t.nets[j].info.type == IP_SUBNET_BGP && t.nets[j].info.bgp.asn == asn)
+        ++lsum;
+  }
+  gettimeofday(&now, NULL);
+  took_us = 1000000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec);
+  printf("Complete on scanning the subnets, %'lu subnets.\n", (unsigned long) lsum);
+  printf("%'u queries in %ldus, %'lu queries/sec.\n\n", 1000, took_us,
+         took_us ? 1000UL * 1000000 / took_us : 0);
+
+  lct_free(&t);
+}
+
+// sample the skewed flow traffic into a profile, and build a trie shaped
+// around it with its busiest nodes up front.  the default trie's depth
+// under the profile comes from laying it out again in its own order.
+void profile_test(lct_subnet_t *p, int num, lct_t *t) {
+  lct_profile_t prof = { NULL, NULL, 1000000 };
+  lct_opts_t popts = { .layout = LCT_LAYOUT_HOT, .profile = &prof };
+  uint32_t flows[4096];
+  lct_t pt;
+
+  if (!(prof.keys = (uint32_t *) malloc(prof.n * sizeof(uint32_t)))) {
+    fprintf(stderr, "Failed to allocate the traffic profile\n");
+    return;
+  }
+  skewed_start(flows);
+  for (uint32_t i = 0; i < prof.n; ++i)
+    prof.keys[i] = skewed_key(flows);
+
+  memset(&pt, 0, sizeof(lct_t));
+  if (!lct_relayout_profile(t, LCT_LAYOUT_DFS, &prof) && !lct_build_opts(&pt, p, num, &popts)) {
+    printf("A profile of %'u sampled skewed lookups walks %1.2f nodes deep in the default trie\n",
+           prof.n, t->prof_depth);
+    printf("and %1.2f nodes deep in a trie of %'u nodes shaped around it, against %'u.\n",
+           pt.prof_depth, pt.ncount, t->ncount);
+    perf_test_skewed(&pt, NULL, "skewed flows on a trie shaped around their profile");
+  }
+
+  lct_free(&pt);
+  free(prof.keys);
+}
+
+// give every tenant its own copy of the table with a few user subnets of
+// its own layered on top, store them all in one multi-table arena, and
+// check every tenant's lookups against a trie of its own
+void multi_test(lct_subnet_t *p, int num) {
+  lct_multi_t multi;
+  lct_subnet_t *tp, *a, *b;
+  lct_ip_stats_t *tstats;
+  lct_t tt;
+  uint32_t key;
+  int tnum, ntables = 0;
+  unsigned long bad = 0;
+
+  tp = (lct_subnet_t *) calloc(num + 8, sizeof(lct_subnet_t));
+  tstats = (lct_ip_stats_t *) calloc(num + 8, sizeof(lct_ip_stats_t));
+  if (!tp || !tstats || lct_multi_init(&multi)) {
+    fprintf(stderr, "Failed to set up the multi-table test\n");
+    free(tp);
+    free(tstats);
+    return;
+  }
+
+  for (int i = 0; i < LCT_MULTI_TENANTS; ++i) {
+    memcpy(tp, p, num * sizeof(lct_subnet_t));
+    tnum = num;
+    for (int j = 0; j < 8; ++j) {
+      tp[tnum].info.type = IP_SUBNET_USER;
+      tp[tnum].info.usr.data = "Tenant host group";
+      tp[tnum].addr = (10U << 24) | (i << 16) | (j << 10);
+      tp[tnum].len = (j % 2) ? 28 : 22;
+      ++tnum;
+    }
+
+    subnet_mask(tp, tnum);
+    qsort(tp, tnum, sizeof(lct_subnet_t), subnet_cmp);
+    tnum -= subnet_dedup(tp, tnum);
+    subnet_prefix(tp, tstats, tnum);
+
+    memset(&tt, 0, sizeof(lct_t));
+    if (lct_build(&tt, tp, tnum) || lct_multi_add(&multi, tp, tnum, NULL) < 0) {
+      lct_free(&tt);
+      break;
+    }
+
+    next = i + 1;
+    for (int k = 0; k < 1000000; ++k) {
+      key = (k % 4) ? fastrand() : (10U << 24) | (i << 16) | (fastrand() & 0x3fff);
+      a = lct_find(&tt, key);
+      b = lct_multi_find(&multi, ntables, key);
+      if ((!a != !b) || (a && (a->addr != b->addr || a->len != b->len ||
+                               a->info.type != b->info.type)))
+        ++bad;
+    }
+    lct_free(&tt);
+    ++ntables;
+  }
+
+  if (!ntables) {
+    fprintf(stderr, "Failed to add any tenant tables\n");
+    lct_multi_free(&multi);
+    free(tstats);
+    free(tp);
+    return;
+  }
+
+  size_t bytes = lct_multi_bytes(&multi);
+  printf("%d tenant tables share a %'lu kB arena with %'u subnets, %'u chain links, and %'u nodes,\n",
+         ntables, bytes / 1024, multi.nnets, multi.nlinks, multi.ncount);
+  printf("instead of %'lu kB as separate tries, with %'lu mismatches against them.\n",
+         (unsigned long) (multi.unshared / 1024), bad);
+
+  unsigned int nhit = 0;
+  struct timeval start, now;
+  next = 1;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < 50000000; i++) {
+    if (lct_multi_find(&multi, i % ntables, fastrand()))
+      ++nhit;
+  }
+  gettimeofday(&now, NULL);
+  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
+
+  printf("Complete on tenant tables in a shared arena.\n");
+  printf("%'u lookups with %'u hits and %'u misses in %ldms.\n", 50000000, nhit,
+         50000000 - nhit, took_ms);
+  printf("%'lu lookups/sec.\n\n", 50000000 / took_ms * 1000);
+
+  lct_multi_free(&multi);
+  free(tstats);
+  free(tp);
+}
+
 int main(int argc, char *argv[]) {
   int num = 0;
   int nprefixes = 0, nbases = 0, nfull = 0;
@@ -284,8 +956,22 @@ int main(int argc, char *argv[]) {
   printf("The resulting trie has %'u nodes using %u %s memory.\n", t.ncount,
          node_bytes / ((node_bytes > 1024) ? (node_bytes > 1024 * 1024) ? 1024 * 1024 : 1024 : 1),
          (node_bytes > 1024) ? (node_bytes > 1024 * 1024) ? "mB" : "kB" : "B");
+  if (t.hot) {
+    uint32_t hot_bytes = num * sizeof(lct_hot_t);
+    printf("The packed hot subnet lookup array uses %u %s memory.\n",
+           hot_bytes / ((hot_bytes > 1024) ? (hot_bytes > 1024 * 1024) ? 1024 * 1024 : 1024 : 1),
+           (hot_bytes > 1024) ? (hot_bytes > 1024 * 1024) ? "mB" : "kB" : "B");
+  }
   printf("The trie's shortest base subnet to match is %hhu bits long\n", t.shortest);
 
+  lct_stats_t tstats;
+  if (!lct_stats(&t, &tstats)) {
+    printf("The trie's expected lookup depth is %1.2f nodes with %1.2f%% of its leaves filling empty slots.\n",
+           tstats.exp_depth, (100.0f * tstats.empty) / tstats.leaves);
+    printf("Trie structure statistics:\n");
+    lct_stats_json(&tstats, stdout);
+  }
+
   printf("\nBeginning test suite...\n\n");
   // TODO run some basic tests with known data sets to test that we're matching base subnets, prefix subnets
   //
@@ -339,48 +1025,237 @@ int main(int argc, char *argv[]) {
   }
   printf("Finished printed trie subnet matches.\n\n");
 
-  printf("Performance testing, might take a while...\n");
+  printf("Testing covering prefix chains for some well known subnets...\n");
+  lct_subnet_t *chain[32];
+  for (int i = 0; test_addr[i] != NULL; ++i) {
+    if (!inet_pton(AF_INET, test_addr[i], (void *) &prefix)) {
+      fprintf(stderr, "ERROR: %s\n", strerror(errno));
+      continue;
+    }
 
-  // init zero stats and seed the RNG
-  unsigned int nlookup = 0, nhit = 0, nmiss = 0;
-  srand(time(NULL));  // not crypto secure, but we don't need that
+    int nchain = lct_find_all(&t, ntohl(prefix), chain, 32);
+    printf("%s is in %d subnets\n", test_addr[i], nchain);
+    for (int j = 0; j < nchain; ++j) {
+      printf("  ");
+      print_subnet(chain[j]);
+    }
+  }
+  printf("Finished printed covering prefix chains.\n\n");
+
+  printf("Testing subnet enumeration of the RFC 1918 private address space and limited broadcast...\n");
+  char *test_range[] = { "10.0.0.0", "172.16.0.0", "192.168.0.0", "255.255.255.255", NULL };
+  uint8_t test_range_len[] = { 8, 12, 16, 32 };
+  for (int i = 0; test_range[i] != NULL; ++i) {
+    lct_range_t it;
+    int nall = 0, nchild = 0;
+
+    inet_pton(AF_INET, test_range[i], (void *) &prefix);
+    for (subnet = lct_range_begin(&it, &t, ntohl(prefix), test_range_len[i], LCT_RANGE_ALL);
+         subnet; subnet = lct_range_next(&it))
+      ++nall;
+
+    printf("%s/%d contains %d subnets, of which the outermost are:\n",
+           test_range[i], test_range_len[i], nall);
+    for (subnet = lct_range_begin(&it, &t, ntohl(prefix), test_range_len[i], LCT_RANGE_CHILDREN);
+         subnet && nchild < 8; subnet = lct_range_next(&it), ++nchild) {
+      printf("  ");
+      print_subnet(subnet);
+    }
+  }
+  printf("Finished subnet enumeration.\n\n");
+
+  // replicate the trie onto a fake two node topology so this can be
+  // exercised on any machine, and check the replicas against the original
+  printf("Testing NUMA replicas on a fake two node topology...\n");
+  uint32_t fake_cpu_node[] = { 0, 1 };
+  lct_numa_topo_t fake_topo = { 2, 2, fake_cpu_node };
+  lct_numa_t numa;
+  if (!lct_numa_init(&numa, &fake_topo)) {
+    if (!lct_numa_publish(&numa, &t) && !lct_numa_publish(&numa, &t)) {
+      int nbad = 0;
+      for (uint32_t node = 0; node < numa.nnodes; ++node) {
+        lct_t *replica = lct_numa_replica(&numa, node);
+        for (int i = 0; test_addr[i] != NULL; ++i) {
+          inet_pton(AF_INET, test_addr[i], (void *) &prefix);
+          if (lct_find(replica, ntohl(prefix)) != lct_find(&t, ntohl(prefix)))
+            ++nbad;
+        }
+      }
+      printf("%d replica lookups differ from the original trie.\n", nbad);
+    }
+    lct_numa_free(&numa);
+  }
+  printf("Finished testing NUMA replicas.\n\n");
+
+  printf("Performance testing, might take a while...\n");
 
   // setup the start of our local range for the test
   inet_pton(AF_INET, "192.168.0.0", (void *) &localprefix);
   localprefix = ntohl(localprefix);
 
-  // start the stop clock
-  struct timeval start, now;
-  gettimeofday(&start, NULL);
-  for (int i = 0; i < 50000000; i++) {
+  srand(time(NULL));  // not crypto secure, but we don't need that
+  perf_test(&t, NULL, "4kB pages");
+
+  // rebuild the trie with the node, bases, and subnet arrays all
+  // on huge pages and run the same lookups again to compare TLB behavior
+  lct_t ht;
+  lct_opts_t hopts = { .alloc = &lct_hugepage_allocator };
+  lct_subnet_t *hp = lct_mem_alloc(&lct_hugepage_allocator, num * sizeof(lct_subnet_t));
+  if (hp) {
+    memcpy(hp, p, num * sizeof(lct_subnet_t));
+    memset(&ht, 0, sizeof(lct_t));
+    if (!lct_build_opts(&ht, hp, num, &hopts)) {
+      perf_test(&ht, NULL, "2mB huge pages");
+      lct_free(&ht);
+    }
+    lct_mem_free(&lct_hugepage_allocator, hp);
+  }
 
-    // just grab a random number and check to match
-    prefix = fastrand();
+  // the same table built for a small appliance and for a big server,
+  // letting the build pick the level compression to fit each budget
+  size_t budgets[] = { 8 * 1024 * 1024, 64 * 1024 * 1024 };
+  for (int i = 0; i < sizeof(budgets) / sizeof(budgets[0]); ++i) {
+    lct_t bt;
+    lct_opts_t bopts = { .budget = budgets[i] };
+    char bdesc[64];
 
-    // record the lookup, hit, and miss stats
-    ++nlookup;
-    subnet = lct_find(&t, prefix);
-    if (subnet) {
-      ++nhit;
-    }
-    else {
-      ++nmiss;
-    }
+    memset(&bt, 0, sizeof(lct_t));
+    if (lct_build_opts(&bt, p, num, &bopts))
+      continue;
 
-    // get the current time
-  } 
-  gettimeofday(&now, NULL);
-  unsigned long took_ms = 1000 * (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000;
-  // timer has millisecond accuracy
+    unsigned long bbytes = bt.ncount * sizeof(lct_node_t) + bt.bcount * sizeof(uint32_t);
+    printf("A budget of %lu kB picked a root branch of %u with a %u%% fill factor,\n",
+           budgets[i] / 1024, bt.root_branch, bt.fill);
+    printf("using %lu kB for an expected lookup depth of %1.2f nodes.\n", bbytes / 1024, bt.exp_depth);
+    snprintf(bdesc, sizeof(bdesc), "a budget of %lu kB", budgets[i] / 1024);
+    perf_test(&bt, NULL, bdesc);
+    lct_free(&bt);
+  }
 
-  printf("Complete.\n");
-printf("%'u lookups with %'u hits and %'u misses in %ldms.\n", nlookup, nhit, nmiss,
-       took_ms);
-  printf("%'lu lookups/sec.\n\n", nlookup / took_ms * 1000);
+  // a fast miss filter in front of the trie at a couple of block sizes
+  uint8_t filters[] = { 20, 24 };
+  for (int i = 0; i < sizeof(filters) / sizeof(filters[0]); ++i) {
+    lct_t ft;
+    lct_opts_t fopts = { .filter_bits = filters[i] };
+    uint64_t uniform = 0;
+    char fdesc[64];
+
+    memset(&ft, 0, sizeof(lct_t));
+    if (lct_build_opts(&ft, p, num, &fopts))
+      continue;
+
+    for (uint32_t g = 0; g < (1 << ft.filter_bits >> 6); ++g)
+      uniform += __builtin_popcountll(ft.filter[g].uniform);
+    unsigned long fbytes = (1 << ft.filter_bits >> 6) * sizeof(lct_filter_t) +
+                           ft.filter_runs * sizeof(uint32_t);
+    printf("A /%u fast miss filter answers %1.1f%% of the address space on its own\n",
+           ft.filter_bits, 100.0 * uniform / (1 << ft.filter_bits));
+    printf("with %'u runs of results in %lu kB.\n", ft.filter_runs, fbytes / 1024);
+    snprintf(fdesc, sizeof(fdesc), "a /%u fast miss filter", ft.filter_bits);
+    perf_test(&ft, NULL, fdesc);
+    lct_free(&ft);
+  }
 
-  printf("Pausing to allow for system analysis.\n");
-  printf("Hit enter key to continue...\n");
-  getc(stdin);
+  // many tenant tables stored together
+  multi_test(p, num);
+
+  // tallying traffic up by ASN through the attribute ids
+  perf_test_attrs(p, num);
+
+  // every prefix an ASN announces, as for pushing to a filter
+  asn_test(p, num);
+
+  // only keeping what a single attribute needs
+  aggregate_test(p, num);
+
+  // offline batches, first one lookup per key and then sorted batches
+  perf_test_batch(&t, 0, "batches of independent lookups");
+  perf_test_batch(&t, 1, "sorted batch lookups");
+
+  // sequential scans, first one lookup per address and then skipping
+  // ahead over the range of every answer
+  perf_test_sweep(&t, 0, "a sequential sweep");
+  perf_test_sweep(&t, 1, "a sequential sweep over answer ranges");
+
+  // streaming batches through classifier threads, first over locked
+  // queues and then over the lock free pipeline
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t nworkers = (ncpus > 2) ? ncpus - 1 : 1;
+  perf_test_pipe(&t, nworkers, 1, "locked queues");
+  perf_test_pipe(&t, nworkers, 0, "lock free pipeline");
+
+  // skewed flow traffic, first straight to the trie and then
+  // through a 16384 entry flow cache
+  perf_test_skewed(&t, NULL, "skewed flows");
+  profile_test(p, num, &t);
+  lct_cache_t cache;
+  if (!lct_cache_init(&cache, 4096)) {
+    perf_test_skewed(&t, &cache, "skewed flows with a flow cache");
+    lct_cache_free(&cache);
+  }
+
+  // only available when the library is built with LCT_INSTRUMENT
+  lct_instr_t instr;
+  if (!lct_instr_snapshot(&instr, 1) && instr.lookups) {
+    printf("Lookup instrumentation over all of the performance tests:\n");
+    printf("%1.2f nodes traversed and %1.2f prefixes checked per lookup.\n",
+           (double) instr.steps / instr.lookups, (double) instr.prefix_steps / instr.lookups);
+    printf("%'lu base hits, %'lu prefix hits, %'lu misses, and %'lu filter hits.\n",
+           instr.base_hits, instr.prefix_hits, instr.misses, instr.filter_hits);
+    printf("Lookups by traversal steps:");
+    for (int i = 0; i < LCT_INSTR_BITS; ++i)
+      if (instr.steps_hist[i])
+        printf(" %d:%'lu", i, instr.steps_hist[i]);
+    printf("\nLookups by prefix chain steps:");
+    for (int i = 0; i < LCT_INSTR_BITS; ++i)
+      if (instr.chain_hist[i])
+        printf(" %d:%'lu", i, instr.chain_hist[i]);
+    printf("\n\n");
+  }
+
+  // count up the traffic of every subnet matched and show the busiest
+  lct_acct_t acct;
+  if (!lct_acct_init(&acct, &t, 1)) {
+    perf_test(&t, &acct, "4kB pages with subnet accounting");
+
+    lct_counter_t *merged = (lct_counter_t *) malloc(acct.nslots * sizeof(lct_counter_t));
+    uint32_t top[10], ntop;
+    if (merged) {
+      lct_acct_merge(&acct, merged);
+      ntop = lct_acct_top(&acct, merged, top, 10);
+      printf("Top %u subnets by hits:\n", ntop);
+      for (uint32_t i = 0; i < ntop; ++i) {
+        printf("%'12lu hits %'16lu bytes  ", merged[top[i]].pkts, merged[top[i]].bytes);
+        print_subnet(&t.nets[top[i]]);
+      }
+      printf("\n");
+
+      // and shape a rebuild around the traffic just counted
+      lct_profile_t aprof;
+      if (lct_acct_profile(&acct, merged, &aprof) > 0) {
+        lct_t at;
+        lct_opts_t aopts = { .layout = LCT_LAYOUT_HOT, .profile = &aprof };
+
+        memset(&at, 0, sizeof(lct_t));
+        if (!lct_build_opts(&at, p, num, &aopts)) {
+          printf("A profile of the %'u subnets counted walks %1.2f nodes deep in a trie built from it.\n\n",
+                 aprof.n, at.prof_depth);
+          lct_free(&at);
+        }
+        free(aprof.keys);
+        free(aprof.weights);
+      }
+      free(merged);
+    }
+    lct_acct_free(&acct);
+  }
+
+  // only pause when someone is there to hit enter
+  if (isatty(STDIN_FILENO)) {
+    printf("Pausing to allow for system analysis.\n");
+    printf("Hit enter key to continue...\n");
+    getc(stdin);
+  }
 
   // we're done with the subnets, stats, and trie;  dump them.
   lct_free(&t);